@@ -0,0 +1,122 @@
+#include "BenchUtil.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define STORM_CONNECTIONS   4000
+
+// Reconnect storm: STORM_CONNECTIONS clients connect back to back and
+// each sends a PING straight away. The storm counts as absorbed once
+// every one of them has its PONG, i.e. the server has accepted and
+// served the whole backlog. Run with a budget of one
+// accept per wakeup (the old behaviour) and with the default budget.
+
+struct StormRun
+{
+    const char*     backend;
+    int             acceptBudget;
+};
+
+static const StormRun runs[] = {
+    { "poll", 1 }, { "poll", 64 },
+    { "epoll", 1 }, { "epoll", 64 }
+};
+
+static bool runStorm(const StormRun& run, int port, size_t connections)
+{
+    Bench::ServerProcess server;
+    std::vector<std::string> options;
+    options.push_back(std::string("--backend=") + run.backend);
+    options.push_back("--accept-budget=" + Utils::intToString(run.acceptBudget));
+    options.push_back("--flood-rate=0");
+    if (!server.start(port, options))
+    {
+        std::cerr << "accept: cannot start ircserv --backend=" << run.backend << std::endl;
+        return false;
+    }
+
+    std::vector<int> sockets;
+    std::vector<struct pollfd> pfds(connections);
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t i = 0; i < connections; ++i)
+    {
+        int fd = Bench::connectTo(port);
+        if (fd == -1 || !Bench::sendAll(fd, "PING :storm\r\n"))
+        {
+            std::cerr << "accept: connection " << i << " failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        sockets.push_back(fd);
+        pfds[i].fd = fd;
+        pfds[i].events = POLLIN;
+    }
+    double connectSeconds = Bench::elapsedMicros(start) / 1000000.0;
+
+    // PONG is the only reply an unregistered client gets to PING, so a
+    // read that contains the token means the client has been served.
+    size_t served = 0;
+    char chunk[4096];
+    while (served < connections && Bench::elapsedMicros(start) < 60000000.0)
+    {
+        if (poll(&pfds[0], pfds.size(), 1000) <= 0)
+            continue;
+        for (size_t i = 0; i < pfds.size(); ++i)
+        {
+            if (pfds[i].fd < 0 || !(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            ssize_t n = recv(pfds[i].fd, chunk, sizeof(chunk), 0);
+            if (n == -1 && errno == EAGAIN)
+                continue;
+            if (n <= 0)
+                return false;
+            if (std::string(chunk, n).find(":storm\r\n") != std::string::npos)
+            {
+                pfds[i].fd = -1;
+                ++served;
+            }
+        }
+    }
+    double seconds = Bench::elapsedMicros(start) / 1000000.0;
+
+    for (size_t i = 0; i < sockets.size(); ++i)
+        close(sockets[i]);
+    if (served < connections)
+    {
+        std::cerr << "accept: " << run.backend << " served only " << served << " connections" << std::endl;
+        return false;
+    }
+
+    std::cout << std::left << std::setw(10) << run.backend << std::right << std::setw(8) << run.acceptBudget
+              << std::setw(12) << std::fixed << std::setprecision(3) << connectSeconds
+              << std::setw(12) << seconds << std::setw(14) << std::setprecision(0)
+              << connections / seconds << std::endl;
+    return true;
+}
+
+int main()
+{
+    size_t fdLimit = Bench::raiseFdLimit();
+    size_t connections = STORM_CONNECTIONS;
+    if (connections > fdLimit - 200)
+        connections = fdLimit - 200;
+    int port = Bench::basePort() + 20;
+
+    std::cout << "== accept: storm of " << connections << " connections, each sending one PING" << std::endl;
+    std::cout << std::left << std::setw(10) << "backend" << std::right << std::setw(8) << "budget"
+              << std::setw(12) << "connect s" << std::setw(12) << "served s" << std::setw(14) << "conns/s"
+              << std::endl;
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i)
+    {
+        if (!runStorm(runs[i], port + static_cast<int>(i), connections))
+            return 1;
+    }
+    return 0;
+}
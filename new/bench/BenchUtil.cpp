@@ -0,0 +1,292 @@
+#include "BenchUtil.hpp"
+#include "Utils.hpp"
+
+#include <new>
+#include <fstream>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define SERVER_START_TIMEOUT_MS     3000
+#define CONNECTIONS_PER_ADDRESS     1000
+
+static unsigned long allocationCount = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    __atomic_fetch_add(&allocationCount, 1, __ATOMIC_RELAXED);
+    void* memory = std::malloc(size > 0 ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) throw()
+{
+    std::free(memory);
+}
+
+namespace Bench
+{
+
+double elapsedMicros(unsigned long long startNanos)
+{
+    return static_cast<double>(Utils::monotonicNanos() - startNanos) / 1000.0;
+}
+
+unsigned long allocations()
+{
+    return __atomic_load_n(&allocationCount, __ATOMIC_RELAXED);
+}
+
+size_t raiseFdLimit()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1)
+        return 1024;
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return static_cast<size_t>(limit.rlim_cur);
+}
+
+int basePort()
+{
+    const char* port = std::getenv("BENCH_PORT");
+    if (port && std::atoi(port) > 0)
+        return std::atoi(port);
+    return BENCH_DEFAULT_PORT;
+}
+
+int connectTo(int port)
+{
+    static unsigned long connections = 0;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    // Spreading connections over 127.0.0.0/8 keeps each destination's
+    // ephemeral port search short; with one address connect() time grows
+    // with every connection already open.
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK + (connections++ / CONNECTIONS_PER_ADDRESS) % 250);
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool sendAll(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.length())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.length() - sent, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+bool readUntil(int fd, const std::string& needle, std::string& buffer, int timeoutMs)
+{
+    unsigned long long deadline = Utils::monotonicNanos() + timeoutMs * 1000000ULL;
+    char chunk[16384];
+    // Only the tail that could still complete a match needs searching again.
+    size_t searchFrom = 0;
+
+    while (buffer.find(needle, searchFrom) == std::string::npos)
+    {
+        searchFrom = buffer.length() >= needle.length() ? buffer.length() - needle.length() + 1 : 0;
+        unsigned long long now = Utils::monotonicNanos();
+        if (now >= deadline)
+            return false;
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ready = poll(&pfd, 1, static_cast<int>((deadline - now) / 1000000ULL) + 1);
+        if (ready == -1 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            return false;
+
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+            return false;
+        buffer.append(chunk, n);
+    }
+    return true;
+}
+
+bool exchangeAll(const std::vector<int>& fds, const std::string& line, const std::string& reply)
+{
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        if (!sendAll(fds[i], line))
+            return false;
+    }
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        std::string buffer;
+        if (!readUntil(fds[i], reply, buffer, 5000))
+            return false;
+    }
+    return true;
+}
+
+static std::string registration(const std::string& nick)
+{
+    return "PASS " BENCH_PASSWORD "\r\nNICK " + nick + "\r\nUSER " + nick + " 0 * :" + nick + "\r\n";
+}
+
+// 005 is the last line of the welcome burst.
+static bool readWelcome(int fd)
+{
+    std::string reply;
+    return readUntil(fd, "are supported by this server\r\n", reply, 5000);
+}
+
+int registerClient(int port, const std::string& nick)
+{
+    int fd = connectTo(port);
+    if (fd == -1)
+        return -1;
+
+    if (!sendAll(fd, registration(nick)) || !readWelcome(fd))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool registerClients(int port, const std::string& prefix, size_t count, std::vector<int>& fds)
+{
+    size_t first = fds.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        int fd = connectTo(port);
+        if (fd == -1)
+            return false;
+        fds.push_back(fd);
+        if (!sendAll(fd, registration(prefix + Utils::intToString(static_cast<int>(i)))))
+            return false;
+    }
+    for (size_t i = first; i < fds.size(); ++i)
+    {
+        if (!readWelcome(fds[i]))
+            return false;
+    }
+    return true;
+}
+
+ServerProcess::ServerProcess() : pid_(-1)
+{
+}
+
+ServerProcess::~ServerProcess()
+{
+    stop();
+}
+
+bool ServerProcess::start(int port, const std::vector<std::string>& options)
+{
+    const char* path = std::getenv("IRCSERV");
+    if (!path)
+        path = "./ircserv";
+
+    std::string portStr = Utils::intToString(port);
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(path));
+    argv.push_back(const_cast<char*>(portStr.c_str()));
+    argv.push_back(const_cast<char*>(BENCH_PASSWORD));
+    for (size_t i = 0; i < options.size(); ++i)
+        argv.push_back(const_cast<char*>(options[i].c_str()));
+    argv.push_back(NULL);
+
+    pid_ = fork();
+    if (pid_ == -1)
+        return false;
+    if (pid_ == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull != -1)
+        {
+            dup2(devNull, STDOUT_FILENO);
+            dup2(devNull, STDERR_FILENO);
+        }
+        execv(path, &argv[0]);
+        _exit(127);
+    }
+
+    unsigned long long deadline = Utils::monotonicNanos() + SERVER_START_TIMEOUT_MS * 1000000ULL;
+    while (Utils::monotonicNanos() < deadline)
+    {
+        int status;
+        if (waitpid(pid_, &status, WNOHANG) == pid_)
+        {
+            pid_ = -1;
+            return false;
+        }
+        int fd = connectTo(port);
+        if (fd != -1)
+        {
+            close(fd);
+            return true;
+        }
+        usleep(10000);
+    }
+    stop();
+    return false;
+}
+
+void ServerProcess::stop()
+{
+    if (pid_ <= 0)
+        return;
+    kill(pid_, SIGINT);
+    int status;
+    while (waitpid(pid_, &status, 0) == -1 && errno == EINTR)
+        ;
+    pid_ = -1;
+}
+
+long ServerProcess::residentKb() const
+{
+    if (pid_ <= 0)
+        return -1;
+    std::ifstream status(("/proc/" + Utils::intToString(pid_) + "/status").c_str());
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+            return std::strtol(line.c_str() + 6, NULL, 10);
+    }
+    return -1;
+}
+
+}
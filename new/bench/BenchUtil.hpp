@@ -0,0 +1,65 @@
+#ifndef BENCHUTIL_HPP
+#define BENCHUTIL_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <sys/types.h>
+
+#define BENCH_PASSWORD      "bench"
+#define BENCH_DEFAULT_PORT  16900
+
+// Shared plumbing for the benchmarks under bench/: timing, an ircserv
+// child process on a loopback port, and blocking test clients.
+namespace Bench
+{
+    double              elapsedMicros(unsigned long long startNanos);
+    // Calls to the global operator new so far in this process; BenchUtil
+    // replaces it with a counting version.
+    unsigned long       allocations();
+
+    // Raises the open file limit to its hard maximum and returns it.
+    size_t              raiseFdLimit();
+
+    // First port for loopback runs: $BENCH_PORT or BENCH_DEFAULT_PORT.
+    int                 basePort();
+
+    int                 connectTo(int port);
+    bool                sendAll(int fd, const std::string& data);
+    // Reads into buffer until it contains needle, up to timeoutMs.
+    // Everything read stays in buffer.
+    bool                readUntil(int fd, const std::string& needle, std::string& buffer, int timeoutMs);
+    // Sends line on every socket, then reads each until reply arrives, so
+    // the round trips overlap instead of adding up.
+    bool                exchangeAll(const std::vector<int>& fds, const std::string& line,
+                                    const std::string& reply);
+    // Connects and completes PASS/NICK/USER; returns the socket or -1.
+    int                 registerClient(int port, const std::string& nick);
+    // Registers prefix0 .. prefix<count - 1> with their handshakes
+    // pipelined and appends the sockets to fds.
+    bool                registerClients(int port, const std::string& prefix, size_t count,
+                                        std::vector<int>& fds);
+
+    // An ircserv child started from $IRCSERV (default ./ircserv) with
+    // output discarded. It is interrupted and reaped on stop().
+    class ServerProcess
+    {
+    private:
+        pid_t           pid_;
+
+        ServerProcess(const ServerProcess&);
+        ServerProcess& operator=(const ServerProcess&);
+
+    public:
+        ServerProcess();
+        ~ServerProcess();
+
+        // Starts the server and waits until it accepts connections.
+        bool            start(int port, const std::vector<std::string>& options);
+        void            stop();
+        // VmRSS of the running server in KiB, or -1 if it cannot be read.
+        long            residentKb() const;
+    };
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "BenchUtil.hpp"
+#include "Channel.hpp"
+#include "ObjectPool.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#define CHURN_CYCLES            1000000
+#define CHURN_BOTS              500
+#define CHURN_JOINS_PER_ROUND   20
+#define CHURN_ROUNDS            30
+#define CHURN_RECONNECTS        50          // bots replaced per round
+#define CHURN_PORT_OFFSET       40
+
+// JOIN/PART churn. In process, one cycle creates a channel and a
+// membership, links them and tears both down again, with the objects
+// either from ObjectPool as the server does or from new/delete. Over
+// loopback, CHURN_BOTS clients each JOIN and PART a channel of their own
+// CHURN_JOINS_PER_ROUND times a round while CHURN_RECONNECTS of them are
+// replaced by fresh connections; the server's VmRSS is sampled after
+// every round and should level off once the pools reach peak occupancy.
+
+static void printCycles(const char* name, unsigned long long start, unsigned long allocationsBefore)
+{
+    double micros = Bench::elapsedMicros(start);
+    double allocations = static_cast<double>(Bench::allocations() - allocationsBefore);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << micros * 1000.0 / CHURN_CYCLES
+              << std::setprecision(2) << std::setw(16) << allocations / CHURN_CYCLES << std::endl;
+}
+
+static void churnInProcess()
+{
+    std::string name("#churn");
+    PoolStats channelStats;
+    PoolStats membershipStats;
+    ObjectPool<Channel> channelPool(channelStats);
+    ObjectPool<Membership> membershipPool(membershipStats);
+
+    std::cout << "== churn: ns and heap allocations per channel create/join/part/destroy cycle" << std::endl;
+    std::cout << std::left << std::setw(10) << "objects" << std::right << std::setw(12) << "ns/cycle"
+              << std::setw(16) << "allocs/cycle" << std::endl;
+
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t i = 0; i < CHURN_CYCLES; ++i)
+    {
+        Channel* channel = new (channelPool.allocate()) Channel(name, 0);
+        Membership* member = new (membershipPool.allocate()) Membership();
+        member->channel = channel;
+        member->fd = 5;
+        channel->addMember(member);
+        channel->removeMember(member);
+        membershipPool.destroy(member);
+        channelPool.destroy(channel);
+    }
+    printCycles("pool", start, allocationsBefore);
+
+    allocationsBefore = Bench::allocations();
+    start = Utils::monotonicNanos();
+    for (size_t i = 0; i < CHURN_CYCLES; ++i)
+    {
+        Channel* channel = new Channel(name, 0);
+        Membership* member = new Membership();
+        member->channel = channel;
+        member->fd = 5;
+        channel->addMember(member);
+        channel->removeMember(member);
+        delete member;
+        delete channel;
+    }
+    printCycles("new", start, allocationsBefore);
+}
+
+// Every bot JOINs and PARTs its own channel, so each cycle creates and
+// frees a Channel and a Membership on the server; the PING marks the end.
+static bool churnRound(const std::vector<int>& fds, size_t round)
+{
+    std::string token = "r" + Utils::intToString(static_cast<int>(round));
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        std::string channel = "#churn" + Utils::intToString(static_cast<int>(i));
+        std::string lines;
+        for (size_t j = 0; j < CHURN_JOINS_PER_ROUND; ++j)
+            lines += "JOIN " + channel + "\r\nPART " + channel + "\r\n";
+        lines += "PING :" + token + "\r\n";
+        if (!Bench::sendAll(fds[i], lines))
+            return false;
+    }
+    for (size_t i = 0; i < fds.size(); ++i)
+    {
+        std::string buffer;
+        if (!Bench::readUntil(fds[i], " :" + token + "\r\n", buffer, 10000))
+            return false;
+    }
+    return true;
+}
+
+static bool churnLoopback(int port)
+{
+    Bench::ServerProcess server;
+    std::vector<std::string> options;
+    options.push_back("--flood-rate=0");
+    if (!server.start(port, options))
+    {
+        std::cerr << "churn: could not start the server" << std::endl;
+        return false;
+    }
+
+    std::vector<int> fds;
+    if (!Bench::registerClients(port, "bot", CHURN_BOTS, fds))
+    {
+        std::cerr << "churn: registration failed" << std::endl;
+        return false;
+    }
+
+    std::cout << "== churn: " << CHURN_BOTS << " bots, " << CHURN_JOINS_PER_ROUND
+              << " JOIN/PART each and " << CHURN_RECONNECTS << " reconnects per round" << std::endl;
+    std::cout << std::setw(6) << "round" << std::setw(14) << "cycles/s" << std::setw(12) << "VmRSS KiB"
+              << std::endl;
+
+    long firstKb = 0;
+    long peakKb = 0;
+    long lastKb = 0;
+    for (size_t round = 0; round < CHURN_ROUNDS; ++round)
+    {
+        unsigned long long start = Utils::monotonicNanos();
+        if (!churnRound(fds, round))
+        {
+            std::cerr << "churn: round " << round << " timed out" << std::endl;
+            return false;
+        }
+        double micros = Bench::elapsedMicros(start);
+
+        // Replace the oldest bots so Client objects churn as well.
+        for (size_t i = 0; i < CHURN_RECONNECTS; ++i)
+            close(fds[i]);
+        fds.erase(fds.begin(), fds.begin() + CHURN_RECONNECTS);
+        std::string prefix = "n" + Utils::intToString(static_cast<int>(round)) + "_";
+        if (!Bench::registerClients(port, prefix, CHURN_RECONNECTS, fds))
+        {
+            std::cerr << "churn: reconnect failed in round " << round << std::endl;
+            return false;
+        }
+
+        lastKb = server.residentKb();
+        if (round == 0)
+            firstKb = lastKb;
+        if (lastKb > peakKb)
+            peakKb = lastKb;
+        if (round % 5 == 0 || round + 1 == CHURN_ROUNDS)
+        {
+            double cycles = static_cast<double>(CHURN_BOTS) * CHURN_JOINS_PER_ROUND;
+            std::cout << std::setw(6) << round << std::fixed << std::setprecision(0)
+                      << std::setw(14) << cycles * 1000000.0 / micros << std::setw(12) << lastKb
+                      << std::endl;
+        }
+    }
+    std::cout << "VmRSS after round 0: " << firstKb << " KiB, peak " << peakKb << " KiB, final "
+              << lastKb << " KiB" << std::endl;
+
+    for (size_t i = 0; i < fds.size(); ++i)
+        close(fds[i]);
+    server.stop();
+    return true;
+}
+
+int main()
+{
+    Bench::raiseFdLimit();
+    churnInProcess();
+    return churnLoopback(Bench::basePort() + CHURN_PORT_OFFSET) ? 0 : 1;
+}
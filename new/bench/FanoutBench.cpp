@@ -0,0 +1,131 @@
+#include "BenchUtil.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define FANOUT_RECEIVERS    100
+#define FANOUT_MESSAGES     5000
+
+// Loopback channel fanout: one client sends FANOUT_MESSAGES PRIVMSGs to a
+// channel of FANOUT_RECEIVERS readers, and the clock stops when every
+// reader has all of them. Compares the backends' per-message syscall
+// costs under the same load.
+
+static const char* const backends[] = { "poll", "epoll", "io_uring" };
+
+static bool runBackend(const char* backend, int port)
+{
+    Bench::ServerProcess server;
+    std::vector<std::string> options;
+    options.push_back(std::string("--backend=") + backend);
+    options.push_back("--flood-rate=0");
+    options.push_back("--sendq=100000000");
+    if (!server.start(port, options))
+    {
+        std::cerr << "fanout: cannot start ircserv --backend=" << backend << std::endl;
+        return false;
+    }
+
+    std::vector<int> receivers;
+    for (int i = 0; i <= FANOUT_RECEIVERS; ++i)
+    {
+        int fd = Bench::registerClient(port, "fan" + Utils::intToString(i));
+        if (fd == -1)
+            return false;
+        receivers.push_back(fd);
+    }
+    // Answering a PING sent after the JOINs flushes every JOIN notice, so
+    // each line read from here on is one of the PRIVMSGs.
+    if (!Bench::exchangeAll(receivers, "JOIN #fanout\r\n", " 366 ")
+        || !Bench::exchangeAll(receivers, "PING :synced\r\n", ":synced\r\n"))
+        return false;
+    int sender = receivers.back();
+    receivers.pop_back();
+    for (size_t i = 0; i < receivers.size(); ++i)
+        fcntl(receivers[i], F_SETFL, O_NONBLOCK);
+    fcntl(sender, F_SETFL, O_NONBLOCK);
+
+    std::string batch;
+    for (int i = 0; i < FANOUT_MESSAGES; ++i)
+        batch += "PRIVMSG #fanout :the quick brown fox jumps over the lazy dog\r\n";
+
+    std::vector<size_t> lines(receivers.size(), 0);
+    std::vector<struct pollfd> pfds(receivers.size() + 1);
+    size_t sent = 0;
+    size_t done = 0;
+    char chunk[65536];
+    unsigned long long start = Utils::monotonicNanos();
+    unsigned long long deadline = start + 60000000000ULL;
+
+    while (done < receivers.size() && Utils::monotonicNanos() < deadline)
+    {
+        for (size_t i = 0; i < receivers.size(); ++i)
+        {
+            pfds[i].fd = lines[i] < FANOUT_MESSAGES ? receivers[i] : -1;
+            pfds[i].events = POLLIN;
+        }
+        pfds[receivers.size()].fd = sent < batch.length() ? sender : -1;
+        pfds[receivers.size()].events = POLLOUT;
+        if (poll(&pfds[0], pfds.size(), 1000) <= 0)
+            continue;
+
+        if (pfds[receivers.size()].revents & POLLOUT)
+        {
+            ssize_t n = send(sender, batch.data() + sent, batch.length() - sent, MSG_NOSIGNAL);
+            if (n > 0)
+                sent += n;
+        }
+        for (size_t i = 0; i < receivers.size(); ++i)
+        {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            ssize_t n = recv(receivers[i], chunk, sizeof(chunk), 0);
+            if (n <= 0 && !(n == -1 && errno == EAGAIN))
+                return false;
+            for (ssize_t j = 0; j < n; ++j)
+            {
+                if (chunk[j] == '\n' && ++lines[i] == FANOUT_MESSAGES)
+                    ++done;
+            }
+        }
+    }
+    double seconds = Bench::elapsedMicros(start) / 1000000.0;
+
+    for (size_t i = 0; i < receivers.size(); ++i)
+        close(receivers[i]);
+    close(sender);
+    if (done < receivers.size())
+    {
+        std::cerr << "fanout: " << backend << " timed out" << std::endl;
+        return false;
+    }
+
+    double delivered = static_cast<double>(FANOUT_MESSAGES) * receivers.size();
+    std::cout << std::left << std::setw(10) << backend << std::right << std::setw(10) << std::fixed
+              << std::setprecision(3) << seconds << std::setw(14) << std::setprecision(0)
+              << delivered / seconds << std::endl;
+    return true;
+}
+
+int main()
+{
+    Bench::raiseFdLimit();
+    int port = Bench::basePort() + 10;
+
+    std::cout << "== fanout: " << FANOUT_MESSAGES << " channel PRIVMSGs to " << FANOUT_RECEIVERS
+              << " readers" << std::endl;
+    std::cout << std::left << std::setw(10) << "backend" << std::right << std::setw(10) << "seconds"
+              << std::setw(14) << "lines/s" << std::endl;
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i)
+    {
+        if (!runBackend(backends[i], port + static_cast<int>(i)))
+            return 1;
+    }
+    return 0;
+}
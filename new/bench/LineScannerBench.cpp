@@ -0,0 +1,123 @@
+#include "BenchUtil.hpp"
+#include "LineScanner.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+
+#define SCAN_CHUNK_SIZE     4096
+#define SCAN_BENCH_BYTES    (256UL * 1024 * 1024)   // scanned per variant
+
+// Finding every line end in a received 4 KiB chunk, for short, typical
+// and long lines. LineScanner runs whichever path it picked at startup;
+// the memchr loop is its scalar fallback; "legacy" repeats the old
+// hasCompleteMessage/extractMessage pattern of two find("\r\n") and two
+// find("\n") calls per line.
+
+static std::string makeChunk(size_t lineLength)
+{
+    std::string chunk;
+    while (chunk.length() + lineLength <= SCAN_CHUNK_SIZE)
+        chunk += std::string(lineLength - 2, 'x') + "\r\n";
+    chunk.resize(SCAN_CHUNK_SIZE, 'x');
+    return chunk;
+}
+
+static size_t scanLineScanner(const std::string& chunk)
+{
+    size_t ends[LINE_SCAN_BATCH];
+    size_t lines = 0;
+    size_t offset = 0;
+    for (;;)
+    {
+        size_t found = LineScanner::findLineEnds(chunk.data() + offset, chunk.length() - offset,
+                                                 ends, LINE_SCAN_BATCH);
+        lines += found;
+        if (found < LINE_SCAN_BATCH)
+            return lines;
+        offset += ends[found - 1] + 1;
+    }
+}
+
+static size_t scanMemchr(const std::string& chunk)
+{
+    const char* data = chunk.data();
+    size_t lines = 0;
+    size_t offset = 0;
+    while (offset < chunk.length())
+    {
+        const void* newline = std::memchr(data + offset, '\n', chunk.length() - offset);
+        if (!newline)
+            break;
+        ++lines;
+        offset = static_cast<const char*>(newline) - data + 1;
+    }
+    return lines;
+}
+
+static size_t findLegacy(const std::string& chunk, size_t offset)
+{
+    size_t pos = chunk.find("\r\n", offset);
+    if (pos == std::string::npos)
+        pos = chunk.find("\n", offset);
+    return pos;
+}
+
+static size_t scanLegacy(const std::string& chunk)
+{
+    size_t lines = 0;
+    size_t offset = 0;
+    // hasCompleteMessage() and extractMessage() each searched again.
+    while (findLegacy(chunk, offset) != std::string::npos)
+    {
+        size_t pos = findLegacy(chunk, offset);
+        ++lines;
+        offset = pos + (chunk[pos] == '\r' ? 2 : 1);
+    }
+    return lines;
+}
+
+int main()
+{
+    static const size_t lineLengths[] = { 16, 80, 400 };
+    const size_t rounds = SCAN_BENCH_BYTES / SCAN_CHUNK_SIZE;
+
+    std::cout << "== linescanner: MB/s over " << SCAN_CHUNK_SIZE << "-byte chunks (LineScanner uses "
+              << LineScanner::implementation() << ")" << std::endl;
+    std::cout << std::right << std::setw(8) << "line" << std::setw(14) << "LineScanner"
+              << std::setw(12) << "memchr" << std::setw(12) << "legacy" << std::endl;
+    for (size_t i = 0; i < sizeof(lineLengths) / sizeof(lineLengths[0]); ++i)
+    {
+        std::string chunk = makeChunk(lineLengths[i]);
+        size_t expected = SCAN_CHUNK_SIZE / lineLengths[i];
+        double results[3];
+
+        for (int variant = 0; variant < 3; ++variant)
+        {
+            unsigned long long start = Utils::monotonicNanos();
+            for (size_t round = 0; round < rounds; ++round)
+            {
+                size_t lines;
+                if (variant == 0)
+                    lines = scanLineScanner(chunk);
+                else if (variant == 1)
+                    lines = scanMemchr(chunk);
+                else
+                    lines = scanLegacy(chunk);
+                if (lines != expected)
+                {
+                    std::cerr << "linescanner: variant " << variant << " found " << lines
+                              << " lines, expected " << expected << std::endl;
+                    return 1;
+                }
+            }
+            results[variant] = static_cast<double>(SCAN_BENCH_BYTES) / Bench::elapsedMicros(start);
+        }
+        std::cout << std::setw(8) << lineLengths[i] << std::fixed << std::setprecision(0)
+                  << std::setw(14) << results[0] << std::setw(12) << results[1]
+                  << std::setw(12) << results[2] << std::endl;
+    }
+    return 0;
+}
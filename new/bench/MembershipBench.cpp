@@ -0,0 +1,173 @@
+#include "BenchUtil.hpp"
+#include "Channel.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <set>
+#include <vector>
+#include <cstdlib>
+
+#define MEMBER_WALK_BUDGET      4000000     // members visited per variant and size
+#define MEMBER_LOOKUPS          1000000
+#define MEMBER_FIRST_FD         5
+
+// Channel membership at 10, 1k and 50k members, in process. "fanout" is
+// the sendToChannel walk over every member but the sender; "NAMES" also
+// tests each member's operator flag; "lookup" is isOperator() on a random
+// member. Each is compared with the set-based Channel it replaced, whose
+// getClients() returned a copy of the member set.
+
+// The std::set<int> membership used before the dense member vector.
+class LegacyChannel
+{
+private:
+    std::set<int>   clients_;
+    std::set<int>   operators_;
+
+public:
+    void            addClient(int fd) { clients_.insert(fd); }
+    void            addOperator(int fd) { operators_.insert(fd); }
+    std::set<int>   getClients() const { return clients_; }
+    bool            isOperator(int fd) const { return operators_.find(fd) != operators_.end(); }
+};
+
+struct Timing
+{
+    double          nanos;
+    double          allocations;
+};
+
+static Timing finish(unsigned long long start, unsigned long allocationsBefore, size_t rounds)
+{
+    Timing timing;
+    timing.nanos = Bench::elapsedMicros(start) * 1000.0 / rounds;
+    timing.allocations = static_cast<double>(Bench::allocations() - allocationsBefore) / rounds;
+    return timing;
+}
+
+static Timing fanoutDense(const Channel& channel, size_t rounds, long& sink)
+{
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        const std::vector<Membership*>& members = channel.getMembers();
+        for (size_t i = 0; i < members.size(); ++i)
+        {
+            if (members[i]->fd != MEMBER_FIRST_FD)
+                sink += members[i]->fd;
+        }
+    }
+    return finish(start, allocationsBefore, rounds);
+}
+
+static Timing fanoutLegacy(const LegacyChannel& channel, size_t rounds, long& sink)
+{
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        std::set<int> clients = channel.getClients();
+        for (std::set<int>::iterator it = clients.begin(); it != clients.end(); ++it)
+        {
+            if (*it != MEMBER_FIRST_FD)
+                sink += *it;
+        }
+    }
+    return finish(start, allocationsBefore, rounds);
+}
+
+static Timing namesDense(const Channel& channel, size_t rounds, long& sink)
+{
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        const std::vector<Membership*>& members = channel.getMembers();
+        for (size_t i = 0; i < members.size(); ++i)
+            sink += (members[i]->flags & MEMBER_OPERATOR) ? 2 : 1;
+    }
+    return finish(start, allocationsBefore, rounds);
+}
+
+static Timing namesLegacy(const LegacyChannel& channel, size_t rounds, long& sink)
+{
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        std::set<int> clients = channel.getClients();
+        for (std::set<int>::iterator it = clients.begin(); it != clients.end(); ++it)
+            sink += channel.isOperator(*it) ? 2 : 1;
+    }
+    return finish(start, allocationsBefore, rounds);
+}
+
+static Timing lookupDense(const Channel& channel, const std::vector<int>& fds, long& sink)
+{
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t i = 0; i < MEMBER_LOOKUPS; ++i)
+        sink += channel.isOperator(fds[i & 4095]);
+    return finish(start, allocationsBefore, MEMBER_LOOKUPS);
+}
+
+static Timing lookupLegacy(const LegacyChannel& channel, const std::vector<int>& fds, long& sink)
+{
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t i = 0; i < MEMBER_LOOKUPS; ++i)
+        sink += channel.isOperator(fds[i & 4095]);
+    return finish(start, allocationsBefore, MEMBER_LOOKUPS);
+}
+
+static void printRow(const char* what, size_t members, const Timing& dense, const Timing& legacy)
+{
+    std::cout << std::left << std::setw(8) << what << std::right << std::setw(8) << members
+              << std::fixed << std::setprecision(1) << std::setw(14) << dense.nanos
+              << std::setw(14) << legacy.nanos << std::setprecision(0) << std::setw(10)
+              << dense.allocations << std::setw(10) << legacy.allocations << std::endl;
+}
+
+int main()
+{
+    static const size_t sizes[] = { 10, 1000, 50000 };
+    long sink = 0;
+
+    std::srand(16);
+    std::cout << "== membership: ns and allocations per operation, dense members vs std::set" << std::endl;
+    std::cout << std::left << std::setw(8) << "op" << std::right << std::setw(8) << "members"
+              << std::setw(14) << "dense ns" << std::setw(14) << "set ns" << std::setw(10) << "dense"
+              << std::setw(10) << "set" << std::endl;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        size_t count = sizes[s];
+        std::vector<Membership> records(count);
+        Channel channel("#bench", 0);
+        LegacyChannel legacy;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Membership& member = records[i];
+            member.client = NULL;
+            member.channel = &channel;
+            member.fd = static_cast<int>(MEMBER_FIRST_FD + i);
+            member.flags = (i % 10 == 0) ? MEMBER_OPERATOR : 0;
+            member.clientIndex = 0;
+            channel.addMember(&member);
+            legacy.addClient(member.fd);
+            if (member.flags & MEMBER_OPERATOR)
+                legacy.addOperator(member.fd);
+        }
+
+        std::vector<int> fds;
+        for (int i = 0; i < 4096; ++i)
+            fds.push_back(static_cast<int>(MEMBER_FIRST_FD + std::rand() % count));
+
+        size_t rounds = MEMBER_WALK_BUDGET / count;
+        printRow("fanout", count, fanoutDense(channel, rounds, sink), fanoutLegacy(legacy, rounds, sink));
+        printRow("NAMES", count, namesDense(channel, rounds, sink), namesLegacy(legacy, rounds, sink));
+        printRow("lookup", count, lookupDense(channel, fds, sink), lookupLegacy(legacy, fds, sink));
+    }
+    return sink == 0;
+}
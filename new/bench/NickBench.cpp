@@ -0,0 +1,136 @@
+#include "BenchUtil.hpp"
+#include "NameIndex.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <unistd.h>
+
+#define NICK_USERS              50000
+#define NICK_DIRECT_MESSAGES    20000
+#define NICK_INDEX_LOOKUPS      1000000
+#define NICK_LEGACY_LOOKUPS     200
+
+// Direct messages with many users connected. The loopback part registers
+// up to NICK_USERS clients (fewer if the open file limit is lower, since
+// both ends live on this host) and times one client sending PRIVMSGs to
+// random nicks. The in-process part always uses NICK_USERS names and
+// compares a NameIndex lookup with the old getClientByNick scan, which
+// lowercased both nicks for every client.
+
+static std::string randomNick(const std::string& prefix, size_t users)
+{
+    std::string nick = prefix + Utils::intToString(static_cast<int>(std::rand() % users));
+    // Mixed case exercises the casemapping.
+    nick[0] = 'U';
+    return nick;
+}
+
+static bool runLoopback(int port, size_t users)
+{
+    Bench::ServerProcess server;
+    std::vector<std::string> options;
+    options.push_back("--flood-rate=0");
+    options.push_back("--expected-clients=" + Utils::intToString(static_cast<int>(users)));
+    if (!server.start(port, options))
+    {
+        std::cerr << "nick: cannot start ircserv" << std::endl;
+        return false;
+    }
+
+    std::vector<int> fds;
+    unsigned long long start = Utils::monotonicNanos();
+    if (!Bench::registerClients(port, "user", users, fds))
+    {
+        std::cerr << "nick: registration failed after " << fds.size() << " clients" << std::endl;
+        return false;
+    }
+    double registerSeconds = Bench::elapsedMicros(start) / 1000000.0;
+    int sender = fds.back();
+
+    std::string batch;
+    for (int i = 0; i < NICK_DIRECT_MESSAGES; ++i)
+        batch += "PRIVMSG " + randomNick("user", users) + " :are you around?\r\n";
+    batch += "PING :sent\r\n";
+
+    std::string reply;
+    start = Utils::monotonicNanos();
+    bool ok = Bench::sendAll(sender, batch) && Bench::readUntil(sender, ":sent\r\n", reply, 60000);
+    double seconds = Bench::elapsedMicros(start) / 1000000.0;
+
+    for (size_t i = 0; i < fds.size(); ++i)
+        close(fds[i]);
+    if (!ok)
+    {
+        std::cerr << "nick: direct messages timed out" << std::endl;
+        return false;
+    }
+
+    std::cout << "loopback: " << users << " users registered in " << std::fixed << std::setprecision(2)
+              << registerSeconds << " s; " << NICK_DIRECT_MESSAGES << " direct messages in "
+              << std::setprecision(3) << seconds << " s (" << std::setprecision(0)
+              << NICK_DIRECT_MESSAGES / seconds << " msg/s)" << std::endl;
+    return true;
+}
+
+// Server::getClientByNick before the index.
+static int legacyFind(const std::vector<std::string>& nicks, const std::string& nick)
+{
+    for (size_t i = 0; i < nicks.size(); ++i)
+    {
+        if (Utils::toLower(nicks[i]) == Utils::toLower(nick))
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+static bool runLookups()
+{
+    std::vector<std::string> nicks;
+    NameIndex index;
+    for (int i = 0; i < NICK_USERS; ++i)
+    {
+        nicks.push_back("user" + Utils::intToString(i));
+        index.insert(nicks.back(), i);
+    }
+
+    std::vector<std::string> queries;
+    for (int i = 0; i < 1024; ++i)
+        queries.push_back(randomNick("user", NICK_USERS));
+
+    unsigned long long start = Utils::monotonicNanos();
+    long found = 0;
+    for (int i = 0; i < NICK_INDEX_LOOKUPS; ++i)
+        found += index.find(queries[i & 1023]) >= 0;
+    double indexNanos = Bench::elapsedMicros(start) * 1000.0 / NICK_INDEX_LOOKUPS;
+
+    start = Utils::monotonicNanos();
+    long legacyFound = 0;
+    for (int i = 0; i < NICK_LEGACY_LOOKUPS; ++i)
+        legacyFound += legacyFind(nicks, queries[i & 1023]) >= 0;
+    double legacyNanos = Bench::elapsedMicros(start) * 1000.0 / NICK_LEGACY_LOOKUPS;
+
+    if (found != NICK_INDEX_LOOKUPS || legacyFound != NICK_LEGACY_LOOKUPS)
+    {
+        std::cerr << "nick: lookups missed a nick" << std::endl;
+        return false;
+    }
+    std::cout << "lookup among " << NICK_USERS << " nicks: NameIndex " << std::fixed << std::setprecision(0)
+              << indexNanos << " ns, old scan " << legacyNanos << " ns" << std::endl;
+    return true;
+}
+
+int main()
+{
+    size_t fdLimit = Bench::raiseFdLimit();
+    size_t users = NICK_USERS;
+    if (users > fdLimit - 200)
+        users = fdLimit - 200;
+
+    std::srand(15);
+    std::cout << "== nick: direct messages by nickname" << std::endl;
+    if (!runLookups() || !runLoopback(Bench::basePort() + 30, users))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "BenchUtil.hpp"
+#include "Client.hpp"
+#include "Reply.hpp"
+#include "SharedBuffer.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstring>
+
+#define PREFIX_BENCH_MESSAGES   2000000
+
+// Sender-side cost of one channel PRIVMSG: rendering the relayed line and
+// wrapping it in the SharedBuffer every member's queue references. "cached"
+// is the current path, Client's cached prefix rendered into a Reply;
+// "legacy" copies target and text, builds nick!user@host per call through
+// by-value getters and concatenates the line into a std::string.
+
+// The identity getters and uncached prefix of Client before the cache.
+class LegacyClient
+{
+private:
+    std::string     nickname_;
+    std::string     username_;
+    std::string     hostname_;
+
+public:
+    LegacyClient(const std::string& nickname, const std::string& username,
+                 const std::string& hostname)
+        : nickname_(nickname), username_(username), hostname_(hostname) {}
+
+    std::string     getNickname() const { return nickname_; }
+    std::string     getUsername() const { return username_; }
+    std::string     getHostname() const { return hostname_; }
+    std::string     getPrefix() const { return nickname_ + "!" + username_ + "@" + hostname_; }
+};
+
+static SharedBuffer* renderCached(const Client& client, const std::vector<std::string>& params)
+{
+    const std::string& target = params[0];
+    Reply privmsg(":");
+    privmsg.append(client.getPrefix()).append(" PRIVMSG ").param(target).trailing(params[1]);
+    return SharedBuffer::create(privmsg.finish(), privmsg.finishedSize());
+}
+
+static SharedBuffer* renderLegacy(const LegacyClient& client, const std::vector<std::string>& params)
+{
+    std::string target = params[0];
+    std::string message = params[1];
+    std::string privmsg = ":" + client.getPrefix() + " PRIVMSG " + target + " :" + message + "\r\n";
+    return SharedBuffer::create(privmsg);
+}
+
+static void printRow(const char* name, unsigned long long start, unsigned long allocationsBefore)
+{
+    double micros = Bench::elapsedMicros(start);
+    double allocations = static_cast<double>(Bench::allocations() - allocationsBefore);
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(12) << micros * 1000.0 / PREFIX_BENCH_MESSAGES
+              << std::setprecision(2) << std::setw(14) << allocations / PREFIX_BENCH_MESSAGES
+              << std::endl;
+}
+
+int main()
+{
+    Client client(5);
+    client.setNickname("alice");
+    client.setUsername("alice");
+    client.setHostname("client-203-0-113-42.example.net");
+    LegacyClient legacy("alice", "alice", "client-203-0-113-42.example.net");
+
+    std::vector<std::string> params;
+    params.push_back("#general");
+    params.push_back("hello everyone, this is a channel message of a fairly ordinary length");
+
+    SharedBuffer* expected = renderCached(client, params);
+    SharedBuffer* check = renderLegacy(legacy, params);
+    bool same = expected->size() == check->size()
+                && std::memcmp(expected->data(), check->data(), check->size()) == 0;
+    expected->release();
+    check->release();
+    if (!same)
+    {
+        std::cerr << "prefix: cached and legacy lines differ" << std::endl;
+        return 1;
+    }
+
+    std::cout << "== prefix: ns and heap allocations per channel PRIVMSG rendered" << std::endl;
+    std::cout << std::left << std::setw(10) << "variant" << std::right << std::setw(12) << "ns/msg"
+              << std::setw(14) << "allocs/msg" << std::endl;
+
+    size_t bytes = 0;
+    unsigned long allocationsBefore = Bench::allocations();
+    unsigned long long start = Utils::monotonicNanos();
+    for (size_t i = 0; i < PREFIX_BENCH_MESSAGES; ++i)
+    {
+        SharedBuffer* buffer = renderCached(client, params);
+        bytes += buffer->size();
+        buffer->release();
+    }
+    printRow("cached", start, allocationsBefore);
+
+    allocationsBefore = Bench::allocations();
+    start = Utils::monotonicNanos();
+    for (size_t i = 0; i < PREFIX_BENCH_MESSAGES; ++i)
+    {
+        SharedBuffer* buffer = renderLegacy(legacy, params);
+        bytes += buffer->size();
+        buffer->release();
+    }
+    printRow("legacy", start, allocationsBefore);
+    return bytes == 0;
+}
@@ -0,0 +1,141 @@
+#include "BenchUtil.hpp"
+#include "RecvBuffer.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+
+#define RECV_BENCH_LINES    400000  // lines pushed through each variant
+#define LEGACY_READ_SIZE    1023    // what the old receiveData read per call
+
+// Line extraction on bursty input: each burst is a paste of N lines that
+// lands in one go. The old Client buffer is reproduced below, fed either
+// the whole burst at once (a large read) or in its old 1023-byte reads;
+// RecvBuffer is fed through writeSpace()/commit() the way readSocket()
+// fills it.
+
+// Client::appendToBuffer / hasCompleteMessage / extractMessage as they
+// were before RecvBuffer.
+class LegacyBuffer
+{
+private:
+    std::string     buffer_;
+
+public:
+    void append(const std::string& data)
+    {
+        buffer_ += data;
+    }
+
+    bool hasCompleteMessage() const
+    {
+        return buffer_.find("\r\n") != std::string::npos || buffer_.find("\n") != std::string::npos;
+    }
+
+    std::string extractMessage()
+    {
+        size_t pos = buffer_.find("\r\n");
+        if (pos == std::string::npos)
+            pos = buffer_.find("\n");
+
+        if (pos != std::string::npos)
+        {
+            std::string message = buffer_.substr(0, pos);
+            if (pos + 1 < buffer_.length() && buffer_[pos] == '\r')
+                buffer_ = buffer_.substr(pos + 2);
+            else
+                buffer_ = buffer_.substr(pos + 1);
+            return message;
+        }
+        return "";
+    }
+};
+
+static std::string makeBurst(size_t lines)
+{
+    std::string burst;
+    for (size_t i = 0; i < lines; ++i)
+        burst += "PRIVMSG #paste :line " + Utils::intToString(static_cast<int>(i)) + " of a pasted block of text\r\n";
+    return burst;
+}
+
+static size_t runLegacy(const std::string& burst, size_t bursts, size_t readSize)
+{
+    LegacyBuffer buffer;
+    size_t bytes = 0;
+    for (size_t b = 0; b < bursts; ++b)
+    {
+        for (size_t offset = 0; offset < burst.length(); offset += readSize)
+        {
+            buffer.append(burst.substr(offset, readSize));
+            while (buffer.hasCompleteMessage())
+                bytes += buffer.extractMessage().length();
+        }
+    }
+    return bytes;
+}
+
+static size_t runRecvBuffer(const std::string& burst, size_t bursts)
+{
+    RecvBuffer buffer;
+    size_t bytes = 0;
+    const char* line;
+    size_t length;
+    for (size_t b = 0; b < bursts; ++b)
+    {
+        size_t offset = 0;
+        while (offset < burst.length())
+        {
+            size_t chunk = buffer.writeSpace();
+            if (chunk > burst.length() - offset)
+                chunk = burst.length() - offset;
+            std::memcpy(buffer.writePtr(), burst.data() + offset, chunk);
+            buffer.commit(chunk);
+            offset += chunk;
+            while (buffer.nextLine(line, length) != LINE_NONE)
+                bytes += length;
+        }
+    }
+    return bytes;
+}
+
+int main()
+{
+    static const size_t burstLines[] = { 1, 20, 200, 1000 };
+
+    std::cout << "== recvbuffer: ns per extracted line, " << RECV_BENCH_LINES << " lines per run" << std::endl;
+    std::cout << std::right << std::setw(8) << "lines" << std::setw(18) << "legacy whole"
+              << std::setw(18) << "legacy 1023B" << std::setw(14) << "RecvBuffer" << std::endl;
+    for (size_t i = 0; i < sizeof(burstLines) / sizeof(burstLines[0]); ++i)
+    {
+        std::string burst = makeBurst(burstLines[i]);
+        size_t bursts = RECV_BENCH_LINES / burstLines[i];
+        size_t expected = (burst.length() - 2 * burstLines[i]) * bursts;
+        double results[3];
+
+        for (int variant = 0; variant < 3; ++variant)
+        {
+            unsigned long long start = Utils::monotonicNanos();
+            size_t bytes;
+            if (variant == 0)
+                bytes = runLegacy(burst, bursts, burst.length());
+            else if (variant == 1)
+                bytes = runLegacy(burst, bursts, LEGACY_READ_SIZE);
+            else
+                bytes = runRecvBuffer(burst, bursts);
+            results[variant] = Bench::elapsedMicros(start) * 1000.0 / RECV_BENCH_LINES;
+            if (bytes != expected)
+            {
+                std::cerr << "recvbuffer: variant " << variant << " extracted " << bytes
+                          << " bytes, expected " << expected << std::endl;
+                return 1;
+            }
+        }
+        std::cout << std::setw(8) << burstLines[i] << std::fixed << std::setprecision(1)
+                  << std::setw(18) << results[0] << std::setw(18) << results[1]
+                  << std::setw(14) << results[2] << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "BenchUtil.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <unistd.h>
+
+#define WAKEUP_WARMUP       300     // also lets the server accept the idle backlog
+#define WAKEUP_ROUNDTRIPS   500
+
+// Cost of one wakeup as the number of idle connections grows: a single
+// client bounces PINGs off the server while more and more connections sit
+// idle next to it. With epoll the round trip should stay flat; poll pays
+// for a scan of every connection on each wakeup.
+
+static const char* const backends[] = { "poll", "epoll" };
+static const size_t idleSteps[] = { 0, 1000, 4000, 16000 };
+
+static double pingRoundTrip(int fd, int rounds)
+{
+    std::string reply;
+    unsigned long long start = Utils::monotonicNanos();
+    for (int i = 0; i < rounds; ++i)
+    {
+        reply.clear();
+        if (!Bench::sendAll(fd, "PING :wakeup\r\n") || !Bench::readUntil(fd, ":wakeup\r\n", reply, 5000))
+            return -1;
+    }
+    return Bench::elapsedMicros(start) / rounds;
+}
+
+static bool runBackend(const char* backend, int port, size_t maxIdle)
+{
+    Bench::ServerProcess server;
+    std::vector<std::string> options;
+    options.push_back(std::string("--backend=") + backend);
+    options.push_back("--flood-rate=0");
+    if (!server.start(port, options))
+    {
+        std::cerr << "wakeup: cannot start ircserv --backend=" << backend << std::endl;
+        return false;
+    }
+
+    int active = Bench::registerClient(port, "active");
+    if (active == -1)
+        return false;
+
+    std::vector<int> idle;
+    bool ok = true;
+    for (size_t step = 0; ok && step < sizeof(idleSteps) / sizeof(idleSteps[0]); ++step)
+    {
+        if (idleSteps[step] > maxIdle)
+            break;
+        while (idle.size() < idleSteps[step])
+        {
+            int fd = Bench::connectTo(port);
+            if (fd == -1)
+            {
+                ok = false;
+                break;
+            }
+            idle.push_back(fd);
+        }
+        if (!ok || pingRoundTrip(active, WAKEUP_WARMUP) < 0)
+        {
+            ok = false;
+            break;
+        }
+
+        double micros = pingRoundTrip(active, WAKEUP_ROUNDTRIPS);
+        ok = micros >= 0;
+        std::cout << std::left << std::setw(10) << backend << std::right << std::setw(8) << idle.size()
+                  << std::setw(14) << std::fixed << std::setprecision(1) << micros << std::endl;
+    }
+
+    for (size_t i = 0; i < idle.size(); ++i)
+        close(idle[i]);
+    close(active);
+    return ok;
+}
+
+int main()
+{
+    // Both ends of every idle connection live on this host.
+    size_t fdLimit = Bench::raiseFdLimit();
+    size_t maxIdle = fdLimit > 200 ? fdLimit - 200 : 0;
+    int port = Bench::basePort();
+
+    std::cout << "== wakeup: PING round trip next to idle connections ("
+              << WAKEUP_ROUNDTRIPS << " samples)" << std::endl;
+    std::cout << std::left << std::setw(10) << "backend" << std::right << std::setw(8) << "idle"
+              << std::setw(14) << "us/roundtrip" << std::endl;
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i)
+    {
+        if (!runBackend(backends[i], port + static_cast<int>(i), maxIdle))
+            return 1;
+    }
+    return 0;
+}
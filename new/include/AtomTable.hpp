@@ -0,0 +1,35 @@
+#ifndef ATOMTABLE_HPP
+#define ATOMTABLE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "NameIndex.hpp"
+
+// Interns IRC names as small reference-counted integers. Names that fold
+// to the same RFC 1459 form share one atom, so holders compare atoms
+// instead of strings. An atom is recycled once its last reference is
+// released; ids stay dense, so callers can index vectors with them.
+class AtomTable
+{
+private:
+    NameIndex                   index_;     // folded name -> atom
+    std::vector<std::string>    names_;     // atom -> name as first interned
+    std::vector<unsigned>       refs_;
+    std::vector<int>            free_;
+
+public:
+    AtomTable();
+
+    // Returns the atom for name, or -1 if it is not interned.
+    int                 find(const std::string& name) const;
+    // Returns name's atom with one more reference, interning it if needed.
+    int                 acquire(const std::string& name);
+    void                retain(int atom);
+    void                release(int atom);
+    const std::string&  name(int atom) const;
+    size_t              size() const;
+};
+
+#endif
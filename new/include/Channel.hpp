@@ -3,19 +3,41 @@
 
 #include <string>
 #include <vector>
-#include <set>
-#include <map>
 
 class Client;
+class Channel;
 
+#define MEMBER_OPERATOR         0x01
+#define MEMBER_VOICE            0x02
+
+// One client's seat in one channel. The record is linked from both the
+// channel's member list and the client's membership list, and each side
+// records its position in the other's list, so either end can unlink it
+// in O(1) without looking anything up by name. The server allocates and
+// frees it.
+struct Membership
+{
+    Client*             client;
+    Channel*            channel;
+    int                 fd;
+    unsigned char       flags;          // MEMBER_* bits
+    size_t              channelIndex;   // position in channel->getMembers()
+    size_t              clientIndex;    // position in client->getMemberships()
+};
+
+// Members live in a dense vector that fanout, NAMES and WHO walk in place;
+// removal swaps the last member into the hole. memberSlots_ is an
+// open-addressing table of positions in members_, keyed by the member's
+// fd, so lookups and removal stay O(1) in mega-channels.
 class Channel
 {
 private:
     std::string             name_;
+    int                     atom_;          // interned name, see Server::atoms_
     std::string             topic_;
     std::string             key_;
-    std::set<int>           clients_;
-    std::set<int>           operators_;
+    std::vector<Membership*> members_;
+    std::vector<int>        memberSlots_;   // -1 = empty
     bool                    inviteOnly_;
     bool                    topicRestricted_;
     bool                    hasKey_;
@@ -23,13 +45,14 @@ private:
     size_t                  userLimit_;
 
 public:
-    Channel(const std::string& name);
+    Channel(const std::string& name, int atom);
     ~Channel();
 
-    std::string         getName() const;
-    std::string         getTopic() const;
-    std::string         getKey() const;
-    std::set<int>       getClients() const;
+    const std::string&  getName() const;
+    int                 getAtom() const;
+    const std::string&  getTopic() const;
+    const std::string&  getKey() const;
+    const std::vector<Membership*>& getMembers() const;
     bool                isInviteOnly() const;
     bool                isTopicRestricted() const;
     bool                hasKey() const;
@@ -45,8 +68,9 @@ public:
     void                setHasLimit(bool value);
     void                setUserLimit(size_t limit);
 
-    void                addClient(int fd);
-    void                removeClient(int fd);
+    void                addMember(Membership* member);
+    void                removeMember(Membership* member);
+    Membership*         findMember(int fd) const;
     bool                hasClient(int fd) const;
     bool                isEmpty() const;
 
@@ -55,6 +79,10 @@ public:
     bool                isOperator(int fd) const;
 
     std::string         getModeString() const;
+
+private:
+    size_t              findSlot(int fd) const;
+    void                rehash(size_t slots);
 };
 
 #endif
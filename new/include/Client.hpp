@@ -3,9 +3,39 @@
 
 #include <string>
 #include <vector>
-#include <set>
+#include <deque>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "RecvBuffer.hpp"
+#include "SharedBuffer.hpp"
+#include "TimerWheel.hpp"
 
 class Channel;
+struct Membership;
+
+// Upper bound on segments handed to one sendmsg().
+#define CLIENT_SEND_IOV     64
+
+// Bytes read from one client per readiness pass. The budget doubles for
+// clients that keep using all of it and halves again once they don't.
+#define CLIENT_READ_BUDGET_MIN  RECV_BUFFER_SIZE
+#define CLIENT_READ_BUDGET_MAX  (64 * 1024)
+
+// A channel INVITE; it lapses at the expires tick.
+struct ClientInvite
+{
+    int             channelAtom;
+    unsigned long   expires;
+};
+
+// One queued outbound message; offset counts bytes already written.
+struct SendSegment
+{
+    SharedBuffer*   buffer;
+    size_t          offset;
+};
 
 class Client
 {
@@ -15,27 +45,57 @@ private:
     std::string             username_;
     std::string             realname_;
     std::string             hostname_;
-    std::string             buffer_;
+    std::string             prefix_;        // nick!user@host, rebuilt by the setters
+    RecvBuffer              recvBuffer_;
+    size_t                  readBudget_;
+    size_t                  readPassBytes_;
+    unsigned long           readPassCalls_;
+    bool                    readPending_;   // budget ran out with data left in the socket
+    std::deque<SendSegment> sendQueue_;
+    size_t                  sendQueueBytes_;
+    struct iovec            sendIov_[CLIENT_SEND_IOV];
+    struct msghdr           sendMsg_;
+    bool                    sendInFlight_;
+    bool                    sendQueueExceeded_;
+    const char*             closeReason_;   // set once ERROR is queued
+    int                     pendingIo_;
+    bool                    flushScheduled_;
+    bool                    writeArmed_;
     bool                    authenticated_;
     bool                    registered_;
     bool                    passOk_;
-    std::set<std::string>   channels_;
-    std::set<std::string>   invitedChannels_;
+    bool                    ircOperator_;   // authenticated with OPER
+    std::vector<Membership*> memberships_;
+    unsigned long           fanoutMark_;
+    std::vector<ClientInvite> invites_;
+    TimerNode               timer_;         // registration, PING or PONG deadline
+    unsigned long           lastActivity_;  // tick of the last line received
+    unsigned long           pingTick_;
+    unsigned long long      pingNanos_;
+    bool                    awaitingPong_;
+    long                    rttMillis_;     // -1 until the first PONG
+    unsigned long long      floodClock_;    // us; when the cost spent so far is earned back
+    bool                    throttled_;
+    std::string             recvBacklog_;   // io_uring input that did not fit while throttled
+    bool                    recvCancelPending_;
+    bool                    recvParked_;    // io_uring recv ended while throttled
+
+    void                updatePrefix();
 
 public:
     Client(int fd);
     ~Client();
 
     int                 getFd() const;
-    std::string         getNickname() const;
-    std::string         getUsername() const;
-    std::string         getRealname() const;
-    std::string         getHostname() const;
-    std::string         getBuffer() const;
+    const std::string&  getNickname() const;
+    const std::string&  getUsername() const;
+    const std::string&  getRealname() const;
+    const std::string&  getHostname() const;
     bool                isAuthenticated() const;
     bool                isRegistered() const;
     bool                hasPassOk() const;
-    std::string         getPrefix() const;
+    bool                isIrcOperator() const;
+    const std::string&  getPrefix() const;
 
     void                setNickname(const std::string& nickname);
     void                setUsername(const std::string& username);
@@ -44,20 +104,74 @@ public:
     void                setAuthenticated(bool value);
     void                setRegistered(bool value);
     void                setPassOk(bool value);
+    void                setIrcOperator(bool value);
+
+    char*               getRecvSpace(size_t& space);
+    void                commitRecv(size_t length);
+    size_t              appendToBuffer(const char* data, size_t length);
+    LineStatus          extractLine(const char*& line, size_t& length);
+    void                startReadPass();
+    size_t              getReadBudgetLeft() const;
+    void                noteRecv(size_t bytes);
+    size_t              getReadPassBytes() const;
+    unsigned long       getReadPassCalls() const;
+    void                adaptReadBudget(bool exhausted);
+    size_t              getReadBudget() const;
+    bool                isReadPending() const;
+    void                setReadPending(bool value);
+    bool                hasRecvBacklog() const;
+    void                holdRecv(const char* data, size_t length);
+    void                refillFromBacklog();
+
+    void                queueSend(SharedBuffer* buffer);
+    bool                hasPendingSend() const;
+    size_t              getSendQueueBytes() const;
+    bool                isSendQueueExceeded() const;
+    void                setSendQueueExceeded();
+    bool                isClosing() const;
+    const char*         getCloseReason() const;
+    void                closeAfterFlush(const char* reason);
+    struct msghdr*      beginSend();
+    bool                isSendInFlight() const;
+    void                completeSend(size_t bytes);
+    bool                isFlushScheduled() const;
+    void                setFlushScheduled(bool value);
+    bool                isWriteArmed() const;
+    void                setWriteArmed(bool value);
+
+    void                addPendingIo();
+    void                releasePendingIo();
+    int                 getPendingIo() const;
+
+    const std::vector<Membership*>& getMemberships() const;
+    void                addMembership(Membership* membership);
+    void                removeMembership(Membership* membership);
+    bool                markFanout(unsigned long epoch);
 
-    void                appendToBuffer(const std::string& data);
-    void                clearBuffer();
-    bool                hasCompleteMessage() const;
-    std::string         extractMessage();
+    const std::vector<ClientInvite>& getInvites() const;
+    bool                addInvite(int channelAtom, unsigned long expires);
+    bool                removeInvite(int channelAtom);
+    bool                isInvited(int channelAtom, unsigned long now) const;
+    void                takeExpiredInvites(unsigned long now, std::vector<int>& channelAtoms);
 
-    void                addChannel(const std::string& channelName);
-    void                removeChannel(const std::string& channelName);
-    bool                isInChannel(const std::string& channelName) const;
-    std::set<std::string> getChannels() const;
+    TimerNode&          getTimer();
+    unsigned long       getLastActivity() const;
+    void                setLastActivity(unsigned long tick);
+    void                notePingSent(unsigned long tick, unsigned long long nanos);
+    bool                isAwaitingPong() const;
+    unsigned long       getPingTick() const;
+    long                notePong(unsigned long long nanos);
+    void                clearAwaitingPong();
+    long                getRttMillis() const;
 
-    void                addInvite(const std::string& channelName);
-    void                removeInvite(const std::string& channelName);
-    bool                isInvited(const std::string& channelName) const;
+    unsigned long long  getFloodClock() const;
+    void                setFloodClock(unsigned long long micros);
+    bool                isThrottled() const;
+    void                setThrottled(bool value);
+    bool                isRecvCancelPending() const;
+    void                setRecvCancelPending(bool value);
+    bool                isRecvParked() const;
+    void                setRecvParked(bool value);
 };
 
 #endif
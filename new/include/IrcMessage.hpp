@@ -0,0 +1,51 @@
+#ifndef IRCMESSAGE_HPP
+#define IRCMESSAGE_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#define IRC_MAX_PARAMS      15
+
+// A [data, data + length) range inside the line being parsed.
+struct MessageSlice
+{
+    const char*     data;
+    size_t          length;
+
+    bool            empty() const;
+    std::string     str() const;
+};
+
+// Parsed form of one line whose fields point into the line itself, so
+// parsing allocates nothing; the view is only valid as long as the line.
+struct MessageView
+{
+    MessageSlice    prefix;
+    MessageSlice    command;
+    MessageSlice    params[IRC_MAX_PARAMS];
+    size_t          paramCount;
+};
+
+// Owning copy of a MessageView for handlers that take std::string
+// parameters. assign() reuses the strings of the previous message.
+struct IrcMessage
+{
+    std::string                 prefix;
+    std::string                 command;
+    std::vector<std::string>    params;
+
+    void            assign(const MessageView& view);
+};
+
+namespace Irc
+{
+    // Splits "[:prefix] COMMAND param... [:trailing]" into view. Runs of
+    // spaces separate parameters, an empty trailing parameter is dropped
+    // and, once IRC_MAX_PARAMS - 1 middle parameters have been read, the
+    // rest of the line becomes the last one. Returns false if there is no
+    // command.
+    bool            parseLine(const char* line, size_t length, MessageView& view);
+}
+
+#endif
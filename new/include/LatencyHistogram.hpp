@@ -0,0 +1,26 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <cstddef>
+
+#define LATENCY_SUB_BITS        2       // buckets per power of two = 1 << LATENCY_SUB_BITS
+#define LATENCY_BUCKETS         (64 << LATENCY_SUB_BITS)
+
+// Log-linear histogram of durations in nanoseconds. Each power of two is
+// split into four buckets, so a percentile read back is the upper edge of
+// a bucket at most 25% wider than its lower edge, capped at the largest
+// value recorded. Recording is a bit scan
+// and one increment; like the other counters it is a plain aggregate so
+// ServerStats can zero it with memset.
+struct LatencyHistogram
+{
+    unsigned long       buckets[LATENCY_BUCKETS];
+
+    void                record(unsigned long long nanos);
+    // Smallest bucket edge that at least fraction of the count lies under,
+    // or max if that is lower: the top bucket's edge may lie past it.
+    unsigned long long  percentile(unsigned long count, double fraction,
+                                   unsigned long long max) const;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef LINESCANNER_HPP
+#define LINESCANNER_HPP
+
+#include <cstddef>
+
+// Maximum line ends returned by one findLineEnds() call.
+#define LINE_SCAN_BATCH     64
+
+// Single-pass LF search over received bytes. On x86 the scan runs 32 bytes
+// at a time with AVX2 when the CPU supports it and 16 bytes at a time with
+// SSE2 otherwise; other targets fall back to memchr().
+namespace LineScanner
+{
+    // Stores the offsets of the first maxEnds LF bytes of data[0, length)
+    // in ends and returns how many were found. When the result equals
+    // maxEnds, scanning resumes after the last offset returned.
+    size_t      findLineEnds(const char* data, size_t length, size_t* ends, size_t maxEnds);
+
+    const char* implementation();
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+#include <string>
+#include <cstddef>
+
+#define LOG_RING_SLOTS          1024        // power of two
+#define LOG_LINE_MAX            600         // a full IRC line plus its label
+
+enum LogLevel
+{
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,
+    LOG_DEBUG
+};
+
+enum LogCategory
+{
+    LOG_SERVER,     // startup, shutdown, reactor failures
+    LOG_CLIENT,     // connects, disconnects, per-client errors
+    LOG_WIRE,       // every line received or sent (debug)
+    LOG_CATEGORY_COUNT
+};
+
+// Leveled logging through a bounded lock-free ring. Any thread formats a
+// line on its own stack and claims a slot with one CAS; a background
+// writer drains the ring to stdout (info, debug) or stderr (warn, error)
+// in batches, so a slow terminal never stalls an event loop. When the
+// ring is full the line is dropped and counted instead of blocking.
+//
+// LOG() tests the level before anything is formatted, so disabled lines
+// cost one relaxed load. Before start() and after stop() lines are
+// written synchronously.
+namespace Log
+{
+    void            start();
+    void            stop();
+
+    void            setLevel(LogLevel level);
+    LogLevel        level();
+    // Async-signal-safe: flips between the configured level and debug.
+    void            toggleDebug();
+    // Keeps one line in every `every` for the category; 1 keeps all.
+    void            setSampling(LogCategory category, unsigned every);
+
+    bool            enabled(LogLevel level, LogCategory category);
+    void            write(LogLevel level, const char* text, size_t length);
+    unsigned long   dropped();
+
+    bool            parseLevel(const std::string& name, LogLevel& level);
+    bool            parseCategory(const std::string& name, LogCategory& category);
+}
+
+// Raw bytes for LogLine, e.g. a line that is not NUL-terminated.
+struct LogBytes
+{
+    const char*     data;
+    size_t          length;
+
+    LogBytes(const char* data, size_t length);
+};
+
+// Formats one line into a fixed buffer and hands it to the ring when it
+// goes out of scope; text past LOG_LINE_MAX is cut.
+class LogLine
+{
+private:
+    LogLevel        level_;
+    char            text_[LOG_LINE_MAX];
+    size_t          length_;
+
+    LogLine(const LogLine&);
+    LogLine& operator=(const LogLine&);
+
+    void            append(const char* data, size_t length);
+    void            appendNumber(unsigned long long value, bool negative);
+
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();
+
+    LogLine&        operator<<(const char* text);
+    LogLine&        operator<<(const std::string& text);
+    LogLine&        operator<<(const LogBytes& bytes);
+    LogLine&        operator<<(char c);
+    LogLine&        operator<<(int value);
+    LogLine&        operator<<(unsigned value);
+    LogLine&        operator<<(long value);
+    LogLine&        operator<<(unsigned long value);
+};
+
+// Expands to a single statement, so it is safe as an unbraced if body.
+#define LOG(level, category) \
+    for (bool logEnabled_ = Log::enabled(level, category); logEnabled_; logEnabled_ = false) \
+        LogLine(level)
+
+#endif
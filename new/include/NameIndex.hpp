@@ -0,0 +1,43 @@
+#ifndef NAMEINDEX_HPP
+#define NAMEINDEX_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Open-addressing hash map from an IRC name to an int, compared under
+// RFC 1459 casemapping (A-Z, []\^ fold to a-z, {}|~). Keys are stored
+// folded; lookups fold on the fly, so find() never allocates. Linear
+// probing with backward-shift deletion keeps probe runs short without
+// tombstones.
+class NameIndex
+{
+private:
+    struct Entry
+    {
+        std::string     key;
+        int             value;
+        bool            used;
+
+        Entry();
+    };
+
+    std::vector<Entry>  entries_;
+    size_t              count_;
+
+    size_t              slotOf(const char* name, size_t length) const;
+    void                grow();
+
+public:
+    NameIndex();
+
+    // Returns the value stored for name, or -1.
+    int                 find(const std::string& name) const;
+    int                 find(const char* name, size_t length) const;
+    // Adds name or replaces its value.
+    void                insert(const std::string& name, int value);
+    bool                erase(const std::string& name);
+    size_t              size() const;
+};
+
+#endif
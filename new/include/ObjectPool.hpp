@@ -0,0 +1,100 @@
+#ifndef OBJECTPOOL_HPP
+#define OBJECTPOOL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// Occupancy of one ObjectPool, kept up to date by the pool itself.
+struct PoolStats
+{
+    size_t          inUse;
+    size_t          peak;
+    size_t          capacity;       // slots carved from slabs so far
+    size_t          slabs;
+
+    PoolStats() : inUse(0), peak(0), capacity(0), slabs(0) {}
+};
+
+#define POOL_SLAB_OBJECTS       64
+
+// Hands out raw storage for T from slabs of fixed-size slots. Freed slots
+// go on a free list and are reused before a new slab is carved, so objects
+// that come and go in a loop recycle the same memory instead of churning
+// the heap. Slabs are only returned when the pool is destroyed. Callers
+// construct with placement new and tear down through destroy(); like the
+// objects it holds, the pool is only touched under the server state lock.
+template <typename T>
+class ObjectPool
+{
+private:
+    union Slot
+    {
+        Slot*       next;
+        char        storage[sizeof(T)];
+        long double alignLongDouble;
+        long long   alignLongLong;
+        void*       alignPointer;
+    };
+
+    std::vector<Slot*>  slabs_;
+    Slot*               free_;
+    PoolStats&          stats_;
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    void addSlab(size_t count)
+    {
+        Slot* slab = static_cast<Slot*>(::operator new(count * sizeof(Slot)));
+        slabs_.push_back(slab);
+        // Thread the new slots onto the free list in address order.
+        for (size_t i = count; i > 0; --i)
+        {
+            slab[i - 1].next = free_;
+            free_ = &slab[i - 1];
+        }
+        stats_.capacity += count;
+        stats_.slabs = slabs_.size();
+    }
+
+public:
+    explicit ObjectPool(PoolStats& stats) : free_(NULL), stats_(stats) {}
+
+    ~ObjectPool()
+    {
+        for (size_t i = 0; i < slabs_.size(); ++i)
+        {
+            ::operator delete(slabs_[i]);
+        }
+    }
+
+    // Carves one slab large enough that count objects fit without another.
+    void reserve(size_t count)
+    {
+        if (count > stats_.capacity)
+            addSlab(count - stats_.capacity);
+    }
+
+    void* allocate()
+    {
+        if (!free_)
+            addSlab(POOL_SLAB_OBJECTS);
+        Slot* slot = free_;
+        free_ = slot->next;
+        if (++stats_.inUse > stats_.peak)
+            stats_.peak = stats_.inUse;
+        return slot;
+    }
+
+    void destroy(T* object)
+    {
+        object->~T();
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = free_;
+        free_ = slot;
+        --stats_.inUse;
+    }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef RECVBUFFER_HPP
+#define RECVBUFFER_HPP
+
+#include <cstddef>
+
+#include "LineScanner.hpp"
+
+#define RECV_BUFFER_SIZE    4096
+#define IRC_MAX_LINE        512     // RFC 1459 limit, CR-LF included
+
+enum LineStatus
+{
+    LINE_NONE,      // no complete line buffered yet
+    LINE_OK,
+    LINE_TOO_LONG   // an over-long line was discarded
+};
+
+// Fixed-capacity receive buffer. Bytes are consumed by advancing a read
+// offset, so extracting a line never shifts the rest of the data; only the
+// unread tail (one partial line in steady state) is moved to the front when
+// the free space at the end runs low. Unscanned bytes are searched in one
+// LineScanner pass that records up to LINE_SCAN_BATCH line ends at once,
+// so every byte is scanned once.
+//
+// A line that grows past IRC_MAX_LINE without a terminator switches the
+// buffer into discard mode: everything up to the next LF is dropped and
+// reported once as LINE_TOO_LONG.
+class RecvBuffer
+{
+private:
+    char        data_[RECV_BUFFER_SIZE];
+    size_t      start_;
+    size_t      end_;
+    size_t      scan_;
+    size_t      lineEnds_[LINE_SCAN_BATCH];
+    size_t      lineCount_;
+    size_t      lineIndex_;
+    bool        discarding_;
+
+    RecvBuffer(const RecvBuffer&);
+    RecvBuffer& operator=(const RecvBuffer&);
+
+    void        compact();
+
+public:
+    RecvBuffer();
+
+    // Free space for a direct recv(); commit() what was written.
+    char*       writePtr();
+    size_t      writeSpace();
+    void        commit(size_t length);
+    size_t      append(const char* data, size_t length);
+
+    // The returned line excludes its CR-LF (or bare LF) and stays valid
+    // until the next write.
+    LineStatus  nextLine(const char*& line, size_t& length);
+
+    bool        empty() const;
+    void        clear();
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef REPLY_HPP
+#define REPLY_HPP
+
+#include <string>
+#include <cstddef>
+
+#include "RecvBuffer.hpp"
+#include "Utils.hpp"
+
+// ":ft_irc NNN " for one of the RPL_* / ERR_* codes, concatenated by the
+// preprocessor so no reply renders the server prefix at runtime.
+#define NUMERIC(code)           ":" SERVER_NAME " " code " "
+
+// A borrowed run of bytes: a string literal or a std::string that outlives
+// the call it is passed to.
+struct ReplyArg
+{
+    const char*     data;
+    size_t          length;
+
+    ReplyArg(const char* text);
+    ReplyArg(const std::string& text);
+};
+
+// Renders one reply line in place. Text past IRC_MAX_LINE is cut so the
+// CR-LF always fits; callers that emit lists check fits() and split them.
+class Reply
+{
+private:
+    char            line_[IRC_MAX_LINE];
+    size_t          length_;
+    bool            params_;
+
+    Reply(const Reply&);
+    Reply& operator=(const Reply&);
+
+public:
+    explicit Reply(const char* prefix);
+
+    Reply&          param(const ReplyArg& arg);     // " arg"
+    Reply&          trailing(const ReplyArg& arg);  // " :arg"
+    Reply&          append(const ReplyArg& arg);    // raw bytes
+    bool            fits(size_t length) const;
+    size_t          size() const;
+    void            truncate(size_t length);
+
+    // Terminates the line with CR-LF; valid until the next change.
+    const char*     finish();
+    size_t          finishedSize() const;
+};
+
+#endif
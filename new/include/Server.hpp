@@ -4,7 +4,6 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <map>
 #include <cstring>
 #include <cstdlib>
 #include <cerrno>
@@ -17,34 +16,319 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <pthread.h>
+#ifdef __linux__
+# include <sys/epoll.h>
+#endif
 
 #include "Client.hpp"
 #include "Channel.hpp"
+#include "IrcMessage.hpp"
+#include "SharedBuffer.hpp"
+#include "Reply.hpp"
+#include "NameIndex.hpp"
+#include "AtomTable.hpp"
+#include "ObjectPool.hpp"
+#include "TimerWheel.hpp"
+#include "LatencyHistogram.hpp"
 
 class Client;
 class Channel;
+class Uring;
+class Server;
+
+#define EPOLL_MAX_EVENTS        256
+#define MAX_REACTOR_THREADS     64
+#define DEFAULT_ACCEPT_BUDGET   64
+#define MAX_ACCEPT_BUDGET       4096
+#define DEFAULT_SENDQ_LIMIT     (1024 * 1024)
+#define MAX_EXPECTED_CLIENTS    1000000
+
+// Flood control: a client earns DEFAULT_FLOOD_RATE command cost units per
+// second and may bank up to DEFAULT_FLOOD_BURST of them. Channel PRIVMSG
+// costs one extra unit per FLOOD_FANOUT_MEMBERS recipients. The burst is
+// sized for a bouncer replaying its JOINs and queued lines on reconnect.
+#define DEFAULT_FLOOD_RATE      10
+#define DEFAULT_FLOOD_BURST     100
+#define MAX_FLOOD_RATE          1000000
+#define MAX_FLOOD_BURST         100000
+#define FLOOD_FANOUT_MEMBERS    100
+
+// Client deadlines, in timer ticks (seconds).
+#define TIMER_TICK_MS           1000
+#define REGISTRATION_TIMEOUT    60      // to finish PASS/NICK/USER
+#define PING_INTERVAL           120     // idle time before the server sends PING
+#define PONG_TIMEOUT            60      // to answer it with any line
+#define INVITE_TIMEOUT          3600    // an INVITE stays usable this long
+#define CLOSE_LINGER            10      // for a closing client's ERROR to drain
+
+// Fixed leading entries of every Reactor::pollFds; clients follow.
+#define REACTOR_LISTEN_SLOT     0
+#define REACTOR_WAKE_SLOT       1
+#define REACTOR_CLIENT_BASE     2
+
+enum IoBackend
+{
+    BACKEND_POLL,
+    BACKEND_EPOLL,
+    BACKEND_URING
+};
+
+// What happens when queueing a message would push a client's SendQ past
+// ServerConfig::sendQueueLimit.
+enum SendQueuePolicy
+{
+    SENDQ_DISCONNECT,   // drop the client with "Excess SendQ"
+    SENDQ_DROP          // drop bulk messages, disconnect only on replies
+};
+
+// Bulk traffic (channel PRIVMSG/NOTICE fanout) is what SENDQ_DROP may shed.
+enum SendPriority
+{
+    SEND_NORMAL,
+    SEND_BULK
+};
+
+enum ReadStatus
+{
+    READ_ERROR,
+    READ_EOF,
+    READ_DRAINED,   // socket returned EAGAIN
+    READ_FULL,      // receive buffer filled up first
+    READ_BUDGET     // the client's read budget ran out first
+};
+
+struct ClientSlot
+{
+    Client*     client;
+    int         reactor;
+    size_t      pollIndex;
+
+    ClientSlot();
+};
+
+// One event loop thread. Each reactor owns a SO_REUSEPORT listening socket,
+// its wait primitive and all I/O of the clients it accepted; shared server
+// state is only touched under Server::stateMutex_. flushQueue lists clients
+// with queued output, retiredClients those removed but not yet freed.
+// timers holds the deadline of each of its clients; throttled those whose
+// flood budget ran out with lines still buffered, and pendingReads (epoll
+// only) those whose read budget ran out before their socket was drained.
+struct Reactor
+{
+    int                         id;
+    int                         listenFd;
+    int                         wakeFds[2];
+    bool                        wakePending;
+    int                         epollFd;
+    Uring*                      uring;
+    std::vector<struct pollfd>  pollFds;
+    std::vector<Client*>        flushQueue;
+    std::vector<Client*>        retiredClients;
+    TimerWheel                  timers;
+    unsigned long long          timerDeadline;  // io_uring: earliest timeout in flight (ms), 0 if none
+    std::vector<Client*>        throttled;
+    unsigned long long          throttleWake;   // earliest release among throttled (us)
+    std::vector<Client*>        pendingReads;
+    pthread_t                   thread;
+    int                         cpu;
+    Server*                     server;
+
+    Reactor(int id, Server* server);
+};
+
+struct ServerConfig
+{
+    IoBackend           backend;
+    int                 threads;
+    std::vector<int>    cpus;
+    int                 acceptBudget;
+    size_t              sendQueueLimit;
+    SendQueuePolicy     sendQueuePolicy;
+    size_t              expectedClients;    // pool pre-sizing hint, 0 = grow on demand
+    std::string         operPassword;       // for OPER; empty leaves it disabled
+    unsigned            floodRate;          // cost units per second, 0 disables flood control
+    unsigned            floodBurst;
+
+    ServerConfig();
+};
+
+enum CommandId
+{
+    CMD_PASS,
+    CMD_NICK,
+    CMD_USER,
+    CMD_JOIN,
+    CMD_PRIVMSG,
+    CMD_KICK,
+    CMD_INVITE,
+    CMD_TOPIC,
+    CMD_MODE,
+    CMD_PART,
+    CMD_QUIT,
+    CMD_WHO,
+    CMD_PING,
+    CMD_PONG,
+    CMD_OPER,
+    CMD_STATS,
+    COMMAND_COUNT
+};
+
+#define COMMAND_SLOTS           32
+
+typedef void (Server::*CommandHandler)(int fd, const std::vector<std::string>& params);
+
+// One row of the dispatch table. minParams is checked before the handler
+// runs; commands whose handlers answer missing parameters with their own
+// reply (or only after other checks) list 0. cost weighs the command for
+// flood accounting.
+struct CommandSpec
+{
+    const char*         name;
+    CommandHandler      handler;
+    size_t              minParams;
+    bool                needsRegistration;
+    unsigned            cost;
+};
+
+struct CommandStats
+{
+    unsigned long       calls;              // messages received, rejected ones included
+    unsigned long       runs;               // handler runs; the latency figures cover these
+    unsigned long       messagesOut;        // lines queued to any client while it ran
+    unsigned long long  totalNanos;
+    unsigned long long  maxNanos;
+    LatencyHistogram    latency;
+};
+
+// Server-wide counters, updated under the state lock.
+struct ServerStats
+{
+    unsigned long       sendQueueDisconnects;
+    unsigned long       sendQueueDrops;
+    unsigned long       sendQueueDroppedBytes;
+    CommandStats        commands[COMMAND_COUNT];
+    unsigned long       unknownCommands;
+    unsigned long       clients;            // connected right now
+    unsigned long       peakClients;
+    unsigned long long  messagesIn;
+    unsigned long long  messagesOut;
+    unsigned long long  sendCalls;
+    unsigned long long  sendBytes;
+    unsigned long       registrationTimeouts;
+    unsigned long       pingTimeouts;
+    unsigned long       pingsSent;
+    unsigned long       pongs;              // PONGs that answered our PING
+    unsigned long long  rttTotalMillis;
+    unsigned long       rttMaxMillis;
+    unsigned long       floodThrottles;     // times a client ran out of flood budget
+    unsigned long long  recvCalls;          // recv() calls or io_uring recv completions
+    unsigned long long  recvBytes;
+    PoolStats           clientPool;
+    PoolStats           channelPool;
+    PoolStats           membershipPool;
+
+    ServerStats();
+};
 
 class Server
 {
 private:
     int                             port_;
     std::string                     password_;
-    int                             serverSocket_;
-    std::vector<struct pollfd>      pollFds_;
-    std::map<int, Client*>          clients_;
-    std::map<std::string, Channel*> channels_;
-    static bool                     signal_;
+    ServerConfig                    config_;
+    std::vector<Reactor*>           reactors_;
+    std::vector<ClientSlot>         clients_;
+    AtomTable                       atoms_;     // channel names, held by channels and invites
+    std::vector<Channel*>           channels_;  // indexed by name atom; NULL if gone
+    NameIndex                       nicks_;     // folded nickname -> fd
+    unsigned long                   fanoutEpoch_;   // see sendToCommonChannels
+    unsigned long                   tick_;          // latest timer tick seen by any reactor
+    unsigned long long              floodUnitMicros_;   // refill time of one cost unit
+    unsigned long long              floodBurstMicros_;  // how far a client may run ahead
+    unsigned long long              startNanos_;
+    int                             currentCommand_;    // CommandId being handled, or -1
+    pthread_mutex_t                 stateMutex_;
+    ServerStats                     stats_;
+    ObjectPool<Client>              clientPool_;
+    ObjectPool<Channel>             channelPool_;
+    ObjectPool<Membership>          membershipPool_;
+    IrcMessage                      message_;   // parseCommand scratch, reused per line
+    static int                      signal_;    // shutdown flag, see requestShutdown()
+
+    static const CommandSpec        commandTable_[COMMAND_COUNT];
+    static const signed char        commandSlots_[COMMAND_SLOTS];
 
     void        initServer();
-    void        acceptClient();
-    void        receiveData(int fd);
-    void        handleClientMessage(int fd, const std::string& message);
-    void        removeClient(int fd);
-    void        parseCommand(int fd, const std::string& message);
+    int         createListenSocket();
+    void        initReactor(Reactor& reactor);
+    void        initEpoll(Reactor& reactor);
+    bool        initUring(Reactor& reactor);
+    void        closeReactor(Reactor& reactor);
+    static void* reactorThread(void* arg);
+    static void requestShutdown();
+    static bool shutdownRequested();
+    void        startWorkers();
+    void        stopWorkers();
+    void        pinReactor(Reactor& reactor);
+    void        runReactor(Reactor& reactor);
+    void        runPoll(Reactor& reactor);
+    void        runEpoll(Reactor& reactor);
+    void        runUring(Reactor& reactor);
+    void        wakeReactor(Reactor& reactor);
+    void        drainWake(Reactor& reactor);
+    void        lockState();
+    void        unlockState();
+    static unsigned long currentTick();
+    void        runTimers(Reactor& reactor);
+    int         timerWaitMillis(Reactor& reactor);
+    TimerWheel& timersOf(int fd);
+    void        handleTimer(Client* client);
+    void        closeClient(Client* client, const char* reason);
+    static unsigned long long currentMicros();
+    bool        isFlooding(Client* client, unsigned long long now);
+    void        chargeFlood(Client* client, unsigned cost);
+    void        throttleClient(Client* client);
+    void        releaseThrottled(Reactor& reactor);
+    void        resumeClient(Reactor& reactor, Client* client);
+
+    void        acceptClient(Reactor& reactor);
+    Client*     registerClient(Reactor& reactor, int clientFd, const struct sockaddr_in& clientAddr);
+    ReadStatus  readClient(int fd);
+    ReadStatus  readSocket(Client* client);
+    void        endReadPass(Client* client, ReadStatus status);
+    void        continueReads(Reactor& reactor);
+    void        finishRead(int fd, ReadStatus status);
+    bool        receiveChunk(Client* client, const char* data, size_t length);
+    void        processMessages(int fd);
+
+    bool        isLiveClient(Client* client);
+    void        uringArmAccept(Reactor& reactor);
+    void        uringArmWake(Reactor& reactor);
+    void        uringArmTimer(Reactor& reactor);
+    void        uringArmRecv(Reactor& reactor, Client* client);
+    void        uringCancelRecv(Reactor& reactor, Client* client);
+    void        uringRestartRecv(Reactor& reactor, Client* client);
+    void        uringSubmitSend(Reactor& reactor, Client* client);
+    void        uringAcceptClient(Reactor& reactor, int clientFd);
+    void        uringComplete(Reactor& reactor, unsigned long long userData, int res, unsigned flags);
+    void        scheduleFlush(int fd);
+    void        flushPendingSends(Reactor& reactor);
+    bool        writeClient(Client* client);
+    void        flushClient(Reactor& reactor, Client* client);
+    void        setWriteInterest(Reactor& reactor, Client* client, bool enable);
+    void        updatePollEvents(Reactor& reactor, Client* client);
+    void        reapRetiredClients(Reactor& reactor);
+    void        handleClientMessage(int fd, const char* line, size_t length);
+    bool        addClient(Client* client, Reactor& reactor);
+    void        removeClient(int fd, const std::string& reason = "Client disconnected");
+    void        parseCommand(int fd, const MessageView& message);
+    static int  findCommand(const MessageSlice& name);
 
     void        handlePass(int fd, const std::vector<std::string>& params);
     void        handleNick(int fd, const std::vector<std::string>& params);
     void        handleUser(int fd, const std::vector<std::string>& params);
+    void        sendWelcome(int fd, Client* client);
     void        handleJoin(int fd, const std::vector<std::string>& params);
     void        handlePrivmsg(int fd, const std::vector<std::string>& params);
     void        handleKick(int fd, const std::vector<std::string>& params);
@@ -54,6 +338,10 @@ private:
     void        handlePart(int fd, const std::vector<std::string>& params);
     void        handleQuit(int fd, const std::vector<std::string>& params);
     void        handleWho(int fd, const std::vector<std::string>& params);
+    void        handlePing(int fd, const std::vector<std::string>& params);
+    void        handlePong(int fd, const std::vector<std::string>& params);
+    void        handleOper(int fd, const std::vector<std::string>& params);
+    void        handleStats(int fd, const std::vector<std::string>& params);
 
     void        handleModeI(Channel* channel, Client* client, bool adding);
     void        handleModeT(Channel* channel, Client* client, bool adding);
@@ -62,12 +350,23 @@ private:
     void        handleModeL(Channel* channel, Client* client, bool adding, const std::string& limit);
 
 public:
-    Server(int port, const std::string& password);
+    Server(int port, const std::string& password, const ServerConfig& config = ServerConfig());
     ~Server();
 
     void        run();
     void        sendToClient(int fd, const std::string& message);
-    void        sendToChannel(Channel* channel, const std::string& message, int excludeFd = -1);
+    void        sendReply(int fd, Reply& reply);
+    void        sendNumeric(int fd, const char* prefix, const ReplyArg& target, const ReplyArg& text);
+    void        sendNumeric(int fd, const char* prefix, const ReplyArg& target, const ReplyArg& arg,
+                            const ReplyArg& text);
+    void        sendNumeric(int fd, const char* prefix, const ReplyArg& target, const ReplyArg& arg1,
+                            const ReplyArg& arg2, const ReplyArg& text);
+    void        sendToClient(int fd, SharedBuffer* buffer, SendPriority priority = SEND_NORMAL);
+    void        sendToChannel(Channel* channel, const std::string& message, int excludeFd = -1,
+                              SendPriority priority = SEND_NORMAL);
+    void        sendToChannel(Channel* channel, SharedBuffer* buffer, int excludeFd = -1,
+                              SendPriority priority = SEND_NORMAL);
+    void        sendToCommonChannels(Client* client, const std::string& message);
     void        broadcastToAll(const std::string& message, int excludeFd = -1);
 
     static void signalHandler(int sig);
@@ -76,9 +375,18 @@ public:
     Client*     getClientByFd(int fd);
     Channel*    getChannel(const std::string& name);
     Channel*    createChannel(const std::string& name, Client* creator);
-    void        removeChannel(const std::string& name);
+    Membership* joinChannel(Client* client, Channel* channel, unsigned char flags);
+    void        leaveChannel(Membership* membership);
+    void        removeChannel(Channel* channel);
     bool        isNickInUse(const std::string& nick);
     std::string getPassword() const;
+    const ServerStats& getStats() const;
+    static const CommandSpec& commandSpec(int id);
+
+    static bool parseBackend(const std::string& name, IoBackend& backend);
+    static bool parseCpuList(const std::string& list, std::vector<int>& cpus);
+    static bool parseSendQueuePolicy(const std::string& name, SendQueuePolicy& policy);
+    static const char* backendName(IoBackend backend);
 };
 
 #endif
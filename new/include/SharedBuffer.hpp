@@ -0,0 +1,40 @@
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include <string>
+#include <cstddef>
+
+struct PoolStats;
+
+// Immutable, reference-counted wire data. A broadcast is serialized once and
+// every recipient's send queue holds a reference to the same buffer instead
+// of its own copy. Reference counts are only touched under the server state
+// lock, so they need no atomics. The bytes follow the header in the same
+// allocation; buffers of up to one IRC line, which is nearly all of them,
+// come from a shared pool of line-sized blocks instead of the heap.
+class SharedBuffer
+{
+private:
+    int             refs_;
+    size_t          size_;
+
+    explicit SharedBuffer(size_t size);
+    ~SharedBuffer();
+    SharedBuffer(const SharedBuffer&);
+    SharedBuffer& operator=(const SharedBuffer&);
+
+public:
+    // The returned buffer starts with one reference owned by the caller.
+    static SharedBuffer* create(const std::string& data);
+    static SharedBuffer* create(const char* data, size_t size);
+
+    void            retain();
+    void            release();
+
+    const char*     data() const;
+    size_t          size() const;
+
+    static const PoolStats& poolStats();
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <cstddef>
+
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS      4       // 2^24 ticks before deadlines clamp
+
+// A timer embedded in the object it belongs to. It is linked into one
+// wheel slot while armed; owner lets the expiry handler find its object.
+struct TimerNode
+{
+    TimerNode*      prev;
+    TimerNode*      next;
+    unsigned long   expires;    // tick
+    void*           owner;
+
+    TimerNode();
+
+    bool            isArmed() const;
+};
+
+// Hierarchical timing wheel. Level 0 has one slot per tick; each higher
+// level covers TIMER_WHEEL_SLOTS slots of the one below, and its slots are
+// cascaded down as level 0 wraps. Scheduling and cancelling are O(1), and
+// advancing costs O(1) per elapsed tick plus the timers it touches.
+class TimerWheel
+{
+private:
+    TimerNode       slots_[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];  // list heads
+    TimerNode       expired_;
+    unsigned long   base_;      // next tick to process
+    size_t          count_;
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    void            place(TimerNode* node);
+    size_t          cascade(int level);
+
+public:
+    TimerWheel();
+
+    void            schedule(TimerNode* node, unsigned long expires);
+    void            cancel(TimerNode* node);
+
+    // Processes every tick up to now, queueing timers that came due.
+    void            advance(unsigned long now);
+    // Unlinks and returns the next due timer, or NULL.
+    TimerNode*      nextExpired();
+    bool            empty() const;
+    size_t          size() const;
+};
+
+#endif
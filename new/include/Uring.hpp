@@ -0,0 +1,85 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+#include <cstddef>
+
+#ifdef __linux__
+# if defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#   include <linux/io_uring.h>
+#  endif
+# endif
+#endif
+
+// Multishot accept/recv and provided buffer rings need the 6.0+ uapi header.
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+# define IRC_HAVE_IO_URING 1
+#endif
+
+#define URING_ENTRIES           1024
+#define URING_BUF_GROUP         0
+#define URING_BUF_COUNT         1024
+#define URING_BUF_SIZE          2048
+
+#ifdef IRC_HAVE_IO_URING
+
+// Thin wrapper over the raw io_uring syscalls: one submission/completion
+// ring pair plus a single provided buffer ring used by multishot recv.
+class Uring
+{
+private:
+    int                     ringFd_;
+    unsigned                sqEntries_;
+    unsigned                cqEntries_;
+
+    void*                   sqRing_;
+    size_t                  sqRingSize_;
+    void*                   cqRing_;
+    size_t                  cqRingSize_;
+    struct io_uring_sqe*    sqes_;
+    size_t                  sqesSize_;
+
+    unsigned*               sqHead_;
+    unsigned*               sqTail_;
+    unsigned*               sqMask_;
+    unsigned*               sqArray_;
+    unsigned*               cqHead_;
+    unsigned*               cqTail_;
+    unsigned*               cqMask_;
+    struct io_uring_cqe*    cqes_;
+
+    unsigned                sqeTail_;
+    unsigned                sqeHead_;
+
+    struct io_uring_buf_ring* bufRing_;
+    size_t                  bufRingSize_;
+    char*                   bufBase_;
+    unsigned short          bufTail_;
+    struct __kernel_timespec timeout_;
+
+    Uring(const Uring&);
+    Uring& operator=(const Uring&);
+
+    void                    flushSq();
+
+public:
+    Uring();
+    ~Uring();
+
+    bool                    init(unsigned entries);
+    bool                    initBufferRing();
+
+    struct io_uring_sqe*    getSqe();
+    void                    prepTimeout(struct io_uring_sqe* sqe, unsigned millis);
+    int                     submit(unsigned waitNr);
+
+    struct io_uring_cqe*    peekCqe();
+    void                    advanceCq();
+
+    char*                   buffer(unsigned short bid);
+    void                    recycleBuffer(unsigned short bid);
+};
+
+#endif
+
+#endif
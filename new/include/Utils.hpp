@@ -9,6 +9,13 @@
 #define RPL_YOURHOST            "002"
 #define RPL_CREATED             "003"
 #define RPL_MYINFO              "004"
+#define RPL_ISUPPORT            "005"
+#define RPL_STATSCOMMANDS       "212"
+#define RPL_ENDOFSTATS          "219"
+#define RPL_UMODEIS             "221"
+#define RPL_STATSUPTIME         "242"
+#define RPL_STATSDEBUG          "249"
+#define RPL_STATSCONN           "250"
 #define RPL_CHANNELMODEIS       "324"
 #define RPL_NOTOPIC             "331"
 #define RPL_TOPIC               "332"
@@ -17,6 +24,7 @@
 #define RPL_ENDOFWHO            "315"
 #define RPL_NAMREPLY            "353"
 #define RPL_ENDOFNAMES          "366"
+#define RPL_YOUREOPER           "381"
 
 #define ERR_NOSUCHNICK          "401"
 #define ERR_NOSUCHCHANNEL       "403"
@@ -25,6 +33,7 @@
 #define ERR_NOORIGIN            "409"
 #define ERR_NORECIPIENT         "411"
 #define ERR_NOTEXTTOSEND        "412"
+#define ERR_INPUTTOOLONG        "417"
 #define ERR_UNKNOWNCOMMAND      "421"
 #define ERR_NONICKNAMEGIVEN     "431"
 #define ERR_ERRONEUSNICKNAME    "432"
@@ -39,7 +48,9 @@
 #define ERR_CHANNELISFULL       "471"
 #define ERR_INVITEONLYCHAN      "473"
 #define ERR_BADCHANNELKEY       "475"
+#define ERR_NOPRIVILEGES        "481"
 #define ERR_CHANOPRIVSNEEDED    "482"
+#define ERR_NOOPERHOST          "491"
 
 #define SERVER_NAME "ft_irc"
 
@@ -49,11 +60,15 @@ namespace Utils
     std::vector<std::string>    splitCommand(const std::string& message);
     std::string                 toUpper(const std::string& str);
     std::string                 toLower(const std::string& str);
+    // RFC 1459 casemapping: A-Z and []\^ fold to a-z and {}|~.
+    char                        foldChar(char c);
+    std::string                 casefold(const std::string& str);
     bool                        isValidNickname(const std::string& nick);
     bool                        isValidChannelName(const std::string& name);
     std::string                 intToString(int num);
     int                         stringToInt(const std::string& str);
     std::string                 trim(const std::string& str);
+    unsigned long long          monotonicNanos();
 }
 
 #endif
@@ -0,0 +1,60 @@
+#include "AtomTable.hpp"
+
+AtomTable::AtomTable()
+{
+}
+
+int AtomTable::find(const std::string& name) const
+{
+    return index_.find(name);
+}
+
+int AtomTable::acquire(const std::string& name)
+{
+    int atom = index_.find(name);
+    if (atom >= 0)
+    {
+        ++refs_[atom];
+        return atom;
+    }
+
+    if (!free_.empty())
+    {
+        atom = free_.back();
+        free_.pop_back();
+        names_[atom] = name;
+        refs_[atom] = 1;
+    }
+    else
+    {
+        atom = static_cast<int>(names_.size());
+        names_.push_back(name);
+        refs_.push_back(1);
+    }
+    index_.insert(name, atom);
+    return atom;
+}
+
+void AtomTable::retain(int atom)
+{
+    ++refs_[atom];
+}
+
+void AtomTable::release(int atom)
+{
+    if (--refs_[atom] > 0)
+        return;
+    index_.erase(names_[atom]);
+    names_[atom].clear();
+    free_.push_back(atom);
+}
+
+const std::string& AtomTable::name(int atom) const
+{
+    return names_[atom];
+}
+
+size_t AtomTable::size() const
+{
+    return names_.size() - free_.size();
+}
@@ -1,7 +1,15 @@
 #include "Channel.hpp"
 #include <sstream>
 
-Channel::Channel(const std::string& name) : name_(name), topic_(""), key_(""), 
+#define CHANNEL_MIN_SLOTS       8
+
+static size_t hashFd(int fd)
+{
+    return static_cast<size_t>(static_cast<unsigned>(fd) * 2654435761u);
+}
+
+Channel::Channel(const std::string& name, int atom) : name_(name), atom_(atom), topic_(""), key_(""), 
+    memberSlots_(CHANNEL_MIN_SLOTS, -1),
     inviteOnly_(false), topicRestricted_(false), hasKey_(false), hasLimit_(false), userLimit_(0)
 {
 }
@@ -10,24 +18,29 @@ Channel::~Channel()
 {
 }
 
-std::string Channel::getName() const
+const std::string& Channel::getName() const
 {
     return name_;
 }
 
-std::string Channel::getTopic() const
+int Channel::getAtom() const
+{
+    return atom_;
+}
+
+const std::string& Channel::getTopic() const
 {
     return topic_;
 }
 
-std::string Channel::getKey() const
+const std::string& Channel::getKey() const
 {
     return key_;
 }
 
-std::set<int> Channel::getClients() const
+const std::vector<Membership*>& Channel::getMembers() const
 {
-    return clients_;
+    return members_;
 }
 
 bool Channel::isInviteOnly() const
@@ -57,7 +70,7 @@ size_t Channel::getUserLimit() const
 
 size_t Channel::getClientCount() const
 {
-    return clients_.size();
+    return members_.size();
 }
 
 void Channel::setTopic(const std::string& topic)
@@ -95,40 +108,109 @@ void Channel::setUserLimit(size_t limit)
     userLimit_ = limit;
 }
 
-void Channel::addClient(int fd)
+// The memberSlots_ entry for fd, or the empty entry where it would go.
+size_t Channel::findSlot(int fd) const
 {
-    clients_.insert(fd);
+    size_t mask = memberSlots_.size() - 1;
+    size_t slot = hashFd(fd) & mask;
+    while (memberSlots_[slot] != -1 && members_[memberSlots_[slot]]->fd != fd)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void Channel::rehash(size_t slots)
+{
+    memberSlots_.assign(slots, -1);
+    for (size_t i = 0; i < members_.size(); ++i)
+    {
+        memberSlots_[findSlot(members_[i]->fd)] = static_cast<int>(i);
+    }
+}
+
+void Channel::addMember(Membership* member)
+{
+    size_t slot = findSlot(member->fd);
+    if (memberSlots_[slot] != -1)
+        return;
+
+    member->channelIndex = members_.size();
+    members_.push_back(member);
+    if (members_.size() * 2 > memberSlots_.size())
+        rehash(memberSlots_.size() * 2);
+    else
+        memberSlots_[slot] = static_cast<int>(member->channelIndex);
+}
+
+// Unlinks member; the caller deletes it.
+void Channel::removeMember(Membership* member)
+{
+    size_t hole = findSlot(member->fd);
+    if (memberSlots_[hole] == -1)
+        return;
+
+    // Backward-shift deletion keeps every probe run unbroken.
+    size_t mask = memberSlots_.size() - 1;
+    size_t next = (hole + 1) & mask;
+    while (memberSlots_[next] != -1)
+    {
+        size_t home = hashFd(members_[memberSlots_[next]]->fd) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            memberSlots_[hole] = memberSlots_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    memberSlots_[hole] = -1;
+
+    // Move the last member into the freed position.
+    size_t index = member->channelIndex;
+    Membership* last = members_.back();
+    if (last != member)
+    {
+        memberSlots_[findSlot(last->fd)] = static_cast<int>(index);
+        members_[index] = last;
+        last->channelIndex = index;
+    }
+    members_.pop_back();
 }
 
-void Channel::removeClient(int fd)
+Membership* Channel::findMember(int fd) const
 {
-    clients_.erase(fd);
-    operators_.erase(fd);
+    int index = memberSlots_[findSlot(fd)];
+    return index == -1 ? NULL : members_[index];
 }
 
 bool Channel::hasClient(int fd) const
 {
-    return clients_.find(fd) != clients_.end();
+    return findMember(fd) != NULL;
 }
 
 bool Channel::isEmpty() const
 {
-    return clients_.empty();
+    return members_.empty();
 }
 
 void Channel::addOperator(int fd)
 {
-    operators_.insert(fd);
+    Membership* member = findMember(fd);
+    if (member)
+        member->flags |= MEMBER_OPERATOR;
 }
 
 void Channel::removeOperator(int fd)
 {
-    operators_.erase(fd);
+    Membership* member = findMember(fd);
+    if (member)
+        member->flags &= ~MEMBER_OPERATOR;
 }
 
 bool Channel::isOperator(int fd) const
 {
-    return operators_.find(fd) != operators_.end();
+    Membership* member = findMember(fd);
+    return member && (member->flags & MEMBER_OPERATOR);
 }
 
 std::string Channel::getModeString() const
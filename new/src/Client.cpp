@@ -1,16 +1,32 @@
 #include "Client.hpp"
+#include "Channel.hpp"
 
-Client::Client(int fd) : fd_(fd), authenticated_(false), registered_(false), passOk_(false)
+#include <cstring>
+
+Client::Client(int fd) : fd_(fd), readBudget_(CLIENT_READ_BUDGET_MIN), readPassBytes_(0),
+    readPassCalls_(0), readPending_(false), sendQueueBytes_(0), sendInFlight_(false),
+    sendQueueExceeded_(false), closeReason_(NULL),
+    pendingIo_(0), flushScheduled_(false), writeArmed_(false),
+    authenticated_(false), registered_(false), passOk_(false), ircOperator_(false),
+    fanoutMark_(0),
+    lastActivity_(0), pingTick_(0), pingNanos_(0), awaitingPong_(false), rttMillis_(-1),
+    floodClock_(0), throttled_(false), recvCancelPending_(false), recvParked_(false)
 {
+    timer_.owner = this;
+    std::memset(&sendMsg_, 0, sizeof(sendMsg_));
     nickname_ = "*";
     username_ = "";
     realname_ = "";
     hostname_ = "";
-    buffer_ = "";
+    updatePrefix();
 }
 
 Client::~Client()
 {
+    for (size_t i = 0; i < sendQueue_.size(); ++i)
+    {
+        sendQueue_[i].buffer->release();
+    }
 }
 
 int Client::getFd() const
@@ -18,31 +34,26 @@ int Client::getFd() const
     return fd_;
 }
 
-std::string Client::getNickname() const
+const std::string& Client::getNickname() const
 {
     return nickname_;
 }
 
-std::string Client::getUsername() const
+const std::string& Client::getUsername() const
 {
     return username_;
 }
 
-std::string Client::getRealname() const
+const std::string& Client::getRealname() const
 {
     return realname_;
 }
 
-std::string Client::getHostname() const
+const std::string& Client::getHostname() const
 {
     return hostname_;
 }
 
-std::string Client::getBuffer() const
-{
-    return buffer_;
-}
-
 bool Client::isAuthenticated() const
 {
     return authenticated_;
@@ -58,19 +69,33 @@ bool Client::hasPassOk() const
     return passOk_;
 }
 
-std::string Client::getPrefix() const
+bool Client::isIrcOperator() const
+{
+    return ircOperator_;
+}
+
+const std::string& Client::getPrefix() const
+{
+    return prefix_;
+}
+
+void Client::updatePrefix()
 {
-    return nickname_ + "!" + username_ + "@" + hostname_;
+    prefix_.clear();
+    prefix_.reserve(nickname_.size() + username_.size() + hostname_.size() + 2);
+    prefix_.append(nickname_).append(1, '!').append(username_).append(1, '@').append(hostname_);
 }
 
 void Client::setNickname(const std::string& nickname)
 {
     nickname_ = nickname;
+    updatePrefix();
 }
 
 void Client::setUsername(const std::string& username)
 {
     username_ = username;
+    updatePrefix();
 }
 
 void Client::setRealname(const std::string& realname)
@@ -81,6 +106,7 @@ void Client::setRealname(const std::string& realname)
 void Client::setHostname(const std::string& hostname)
 {
     hostname_ = hostname;
+    updatePrefix();
 }
 
 void Client::setAuthenticated(bool value)
@@ -98,72 +124,423 @@ void Client::setPassOk(bool value)
     passOk_ = value;
 }
 
-void Client::appendToBuffer(const std::string& data)
+void Client::setIrcOperator(bool value)
+{
+    ircOperator_ = value;
+}
+
+char* Client::getRecvSpace(size_t& space)
+{
+    space = recvBuffer_.writeSpace();
+    return recvBuffer_.writePtr();
+}
+
+void Client::commitRecv(size_t length)
+{
+    recvBuffer_.commit(length);
+}
+
+// Stores as much of data as fits and returns the byte count; the caller
+// has to extract lines before the rest can be appended.
+size_t Client::appendToBuffer(const char* data, size_t length)
+{
+    return recvBuffer_.append(data, length);
+}
+
+LineStatus Client::extractLine(const char*& line, size_t& length)
+{
+    return recvBuffer_.nextLine(line, length);
+}
+
+void Client::startReadPass()
+{
+    readPassBytes_ = 0;
+    readPassCalls_ = 0;
+}
+
+size_t Client::getReadBudgetLeft() const
+{
+    return readPassBytes_ < readBudget_ ? readBudget_ - readPassBytes_ : 0;
+}
+
+void Client::noteRecv(size_t bytes)
+{
+    readPassBytes_ += bytes;
+    ++readPassCalls_;
+}
+
+size_t Client::getReadPassBytes() const
+{
+    return readPassBytes_;
+}
+
+unsigned long Client::getReadPassCalls() const
+{
+    return readPassCalls_;
+}
+
+// Called at the end of a pass: clients that used the whole budget (bouncers,
+// relay bots) get twice as much next time; one that read under a quarter
+// of it drops back by half.
+void Client::adaptReadBudget(bool exhausted)
+{
+    if (exhausted)
+    {
+        if (readBudget_ < CLIENT_READ_BUDGET_MAX)
+            readBudget_ *= 2;
+    }
+    else if (readPassBytes_ < readBudget_ / 4 && readBudget_ > CLIENT_READ_BUDGET_MIN)
+        readBudget_ /= 2;
+}
+
+size_t Client::getReadBudget() const
+{
+    return readBudget_;
+}
+
+bool Client::isReadPending() const
+{
+    return readPending_;
+}
+
+void Client::setReadPending(bool value)
+{
+    readPending_ = value;
+}
+
+bool Client::hasRecvBacklog() const
+{
+    return !recvBacklog_.empty();
+}
+
+// Keeps input that arrived while the receive buffer was full; it must be
+// fed back in order before anything received later.
+void Client::holdRecv(const char* data, size_t length)
+{
+    recvBacklog_.append(data, length);
+}
+
+void Client::refillFromBacklog()
+{
+    size_t stored = recvBuffer_.append(recvBacklog_.data(), recvBacklog_.length());
+    recvBacklog_.erase(0, stored);
+}
+
+void Client::queueSend(SharedBuffer* buffer)
+{
+    if (buffer->size() == 0)
+        return;
+
+    SendSegment segment;
+    segment.buffer = buffer;
+    segment.offset = 0;
+    buffer->retain();
+    sendQueue_.push_back(segment);
+    sendQueueBytes_ += buffer->size();
+}
+
+bool Client::hasPendingSend() const
+{
+    return !sendQueue_.empty();
+}
+
+size_t Client::getSendQueueBytes() const
+{
+    return sendQueueBytes_;
+}
+
+bool Client::isSendQueueExceeded() const
+{
+    return sendQueueExceeded_;
+}
+
+// Marks the client for an "Excess SendQ" disconnect; nothing more is queued.
+void Client::setSendQueueExceeded()
+{
+    sendQueueExceeded_ = true;
+}
+
+bool Client::isClosing() const
+{
+    return closeReason_ != NULL;
+}
+
+const char* Client::getCloseReason() const
+{
+    return closeReason_;
+}
+
+// Marks the client for a disconnect once what is queued has been written;
+// nothing more is queued or read meanwhile. reason must be a literal.
+void Client::closeAfterFlush(const char* reason)
 {
-    buffer_ += data;
+    closeReason_ = reason;
 }
 
-void Client::clearBuffer()
+// Gathers the head of the send queue into one message for sendmsg() or an
+// io_uring SENDMSG. The segments stay queued, and the iovecs valid, until
+// completeSend() reports how many bytes went out; messages queued meanwhile
+// are appended behind them.
+struct msghdr* Client::beginSend()
 {
-    buffer_.clear();
+    size_t count = 0;
+    for (std::deque<SendSegment>::iterator it = sendQueue_.begin();
+         it != sendQueue_.end() && count < CLIENT_SEND_IOV; ++it)
+    {
+        sendIov_[count].iov_base = const_cast<char*>(it->buffer->data() + it->offset);
+        sendIov_[count].iov_len = it->buffer->size() - it->offset;
+        ++count;
+    }
+
+    std::memset(&sendMsg_, 0, sizeof(sendMsg_));
+    sendMsg_.msg_iov = sendIov_;
+    sendMsg_.msg_iovlen = count;
+    sendInFlight_ = true;
+    return &sendMsg_;
 }
 
-bool Client::hasCompleteMessage() const
+bool Client::isSendInFlight() const
 {
-    return buffer_.find("\r\n") != std::string::npos || buffer_.find("\n") != std::string::npos;
+    return sendInFlight_;
 }
 
-std::string Client::extractMessage()
+void Client::completeSend(size_t bytes)
 {
-    size_t pos = buffer_.find("\r\n");
-    if (pos == std::string::npos)
+    sendInFlight_ = false;
+    sendQueueBytes_ -= bytes;
+    while (bytes > 0)
     {
-        pos = buffer_.find("\n");
+        SendSegment& head = sendQueue_.front();
+        size_t remaining = head.buffer->size() - head.offset;
+        if (bytes < remaining)
+        {
+            head.offset += bytes;
+            return;
+        }
+        bytes -= remaining;
+        head.buffer->release();
+        sendQueue_.pop_front();
     }
-    
-    if (pos != std::string::npos)
+}
+
+bool Client::isFlushScheduled() const
+{
+    return flushScheduled_;
+}
+
+void Client::setFlushScheduled(bool value)
+{
+    flushScheduled_ = value;
+}
+
+bool Client::isWriteArmed() const
+{
+    return writeArmed_;
+}
+
+void Client::setWriteArmed(bool value)
+{
+    writeArmed_ = value;
+}
+
+void Client::addPendingIo()
+{
+    ++pendingIo_;
+}
+
+void Client::releasePendingIo()
+{
+    --pendingIo_;
+}
+
+int Client::getPendingIo() const
+{
+    return pendingIo_;
+}
+
+const std::vector<Membership*>& Client::getMemberships() const
+{
+    return memberships_;
+}
+
+void Client::addMembership(Membership* membership)
+{
+    membership->clientIndex = memberships_.size();
+    memberships_.push_back(membership);
+}
+
+void Client::removeMembership(Membership* membership)
+{
+    size_t index = membership->clientIndex;
+    Membership* last = memberships_.back();
+    memberships_[index] = last;
+    last->clientIndex = index;
+    memberships_.pop_back();
+}
+
+// True the first time it is called for a given epoch; fanout to several
+// channels uses it so a client sharing more than one gets a single copy.
+bool Client::markFanout(unsigned long epoch)
+{
+    if (fanoutMark_ == epoch)
+        return false;
+    fanoutMark_ = epoch;
+    return true;
+}
+
+const std::vector<ClientInvite>& Client::getInvites() const
+{
+    return invites_;
+}
+
+// Returns false if the client was already invited; the deadline is renewed.
+bool Client::addInvite(int channelAtom, unsigned long expires)
+{
+    for (size_t i = 0; i < invites_.size(); ++i)
     {
-        std::string message = buffer_.substr(0, pos);
-        if (pos + 1 < buffer_.length() && buffer_[pos] == '\r')
-            buffer_ = buffer_.substr(pos + 2);
+        if (invites_[i].channelAtom == channelAtom)
+        {
+            invites_[i].expires = expires;
+            return false;
+        }
+    }
+    ClientInvite invite;
+    invite.channelAtom = channelAtom;
+    invite.expires = expires;
+    invites_.push_back(invite);
+    return true;
+}
+
+// Returns false if the client held no such invite.
+bool Client::removeInvite(int channelAtom)
+{
+    for (size_t i = 0; i < invites_.size(); ++i)
+    {
+        if (invites_[i].channelAtom == channelAtom)
+        {
+            invites_[i] = invites_.back();
+            invites_.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Client::isInvited(int channelAtom, unsigned long now) const
+{
+    for (size_t i = 0; i < invites_.size(); ++i)
+    {
+        if (invites_[i].channelAtom == channelAtom)
+            return invites_[i].expires > now;
+    }
+    return false;
+}
+
+// Drops lapsed invites, appending their channel atoms for the caller to
+// release.
+void Client::takeExpiredInvites(unsigned long now, std::vector<int>& channelAtoms)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < invites_.size(); ++i)
+    {
+        if (invites_[i].expires > now)
+            invites_[kept++] = invites_[i];
         else
-            buffer_ = buffer_.substr(pos + 1);
-        return message;
+            channelAtoms.push_back(invites_[i].channelAtom);
     }
-    return "";
+    invites_.resize(kept);
+}
+
+TimerNode& Client::getTimer()
+{
+    return timer_;
+}
+
+unsigned long Client::getLastActivity() const
+{
+    return lastActivity_;
+}
+
+void Client::setLastActivity(unsigned long tick)
+{
+    lastActivity_ = tick;
+}
+
+void Client::notePingSent(unsigned long tick, unsigned long long nanos)
+{
+    pingTick_ = tick;
+    pingNanos_ = nanos;
+    awaitingPong_ = true;
+}
+
+bool Client::isAwaitingPong() const
+{
+    return awaitingPong_;
+}
+
+unsigned long Client::getPingTick() const
+{
+    return pingTick_;
+}
+
+// Records the round trip of the outstanding PING; returns it in
+// milliseconds, or -1 if none was outstanding.
+long Client::notePong(unsigned long long nanos)
+{
+    if (!awaitingPong_)
+        return -1;
+    awaitingPong_ = false;
+    rttMillis_ = static_cast<long>((nanos - pingNanos_) / 1000000ULL);
+    return rttMillis_;
+}
+
+void Client::clearAwaitingPong()
+{
+    awaitingPong_ = false;
+}
+
+// The last keepalive round trip in milliseconds, -1 before the first PONG.
+long Client::getRttMillis() const
+{
+    return rttMillis_;
+}
+
+unsigned long long Client::getFloodClock() const
+{
+    return floodClock_;
 }
 
-void Client::addChannel(const std::string& channelName)
+void Client::setFloodClock(unsigned long long micros)
 {
-    channels_.insert(channelName);
+    floodClock_ = micros;
 }
 
-void Client::removeChannel(const std::string& channelName)
+bool Client::isThrottled() const
 {
-    channels_.erase(channelName);
+    return throttled_;
 }
 
-bool Client::isInChannel(const std::string& channelName) const
+void Client::setThrottled(bool value)
 {
-    return channels_.find(channelName) != channels_.end();
+    throttled_ = value;
 }
 
-std::set<std::string> Client::getChannels() const
+bool Client::isRecvCancelPending() const
 {
-    return channels_;
+    return recvCancelPending_;
 }
 
-void Client::addInvite(const std::string& channelName)
+void Client::setRecvCancelPending(bool value)
 {
-    invitedChannels_.insert(channelName);
+    recvCancelPending_ = value;
 }
 
-void Client::removeInvite(const std::string& channelName)
+bool Client::isRecvParked() const
 {
-    invitedChannels_.erase(channelName);
+    return recvParked_;
 }
 
-bool Client::isInvited(const std::string& channelName) const
+void Client::setRecvParked(bool value)
 {
-    return invitedChannels_.find(channelName) != invitedChannels_.end();
+    recvParked_ = value;
 }
@@ -1,80 +1,154 @@
 #include "Server.hpp"
 #include "Utils.hpp"
+#include "Logger.hpp"
 
-void Server::parseCommand(int fd, const std::string& message)
+#include <iomanip>
+
+// Indexed by CommandId. PASS and USER check their parameters themselves
+// because ERR_ALREADYREGISTERED and the password test come first.
+const CommandSpec Server::commandTable_[COMMAND_COUNT] =
 {
-    std::vector<std::string> tokens = Utils::splitCommand(message);
-    
-    if (tokens.empty())
-        return;
-    
-    std::string command = Utils::toUpper(tokens[0]);
-    std::vector<std::string> params(tokens.begin() + 1, tokens.end());
-    
-    Client* client = clients_[fd];
-    
-    if (command == "PASS")
-    {
-        handlePass(fd, params);
-        return;
-    }
-    else if (command == "NICK")
+    { "PASS",    &Server::handlePass,    0, false, 1 },
+    { "NICK",    &Server::handleNick,    0, false, 1 },
+    { "USER",    &Server::handleUser,    0, false, 1 },
+    { "JOIN",    &Server::handleJoin,    1, true,  2 },
+    { "PRIVMSG", &Server::handlePrivmsg, 0, true,  1 },
+    { "KICK",    &Server::handleKick,    2, true,  1 },
+    { "INVITE",  &Server::handleInvite,  2, true,  1 },
+    { "TOPIC",   &Server::handleTopic,   1, true,  1 },
+    { "MODE",    &Server::handleMode,    1, true,  1 },
+    { "PART",    &Server::handlePart,    1, true,  1 },
+    { "QUIT",    &Server::handleQuit,    0, true,  1 },
+    { "WHO",     &Server::handleWho,     0, true,  3 },
+    { "PING",    &Server::handlePing,    0, false, 1 },
+    { "PONG",    &Server::handlePong,    0, false, 0 },
+    { "OPER",    &Server::handleOper,    2, true,  1 },
+    { "STATS",   &Server::handleStats,   1, true,  3 }
+};
+
+// commandHash() is collision-free over the names above; each slot holds
+// the CommandId hashing to it, or -1. Adding a command means picking new
+// multipliers that keep the names apart.
+const signed char Server::commandSlots_[COMMAND_SLOTS] =
+{
+    -1,         CMD_WHO,    -1,         CMD_PASS,
+    -1,         -1,         -1,         CMD_USER,
+    CMD_JOIN,   -1,         -1,         -1,
+    CMD_PART,   -1,         -1,         CMD_PONG,
+    CMD_TOPIC,  -1,         -1,         CMD_STATS,
+    CMD_INVITE, CMD_OPER,   CMD_KICK,   CMD_PING,
+    -1,         CMD_NICK,   CMD_MODE,   -1,
+    -1,         CMD_QUIT,   CMD_PRIVMSG, -1
+};
+
+static unsigned char foldCommandChar(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        c -= 'a' - 'A';
+    return static_cast<unsigned char>(c);
+}
+
+// First, second and last letter plus length: PING and PONG only differ
+// in the second.
+static unsigned commandHash(const char* name, size_t length)
+{
+    unsigned second = length > 1 ? foldCommandChar(name[1]) : 0;
+    return (foldCommandChar(name[0]) + second * 4u + foldCommandChar(name[length - 1]) * 9u
+            + static_cast<unsigned>(length)) & (COMMAND_SLOTS - 1);
+}
+
+int Server::findCommand(const MessageSlice& name)
+{
+    if (name.length == 0)
+        return -1;
+
+    int id = commandSlots_[commandHash(name.data, name.length)];
+    if (id < 0)
+        return -1;
+
+    const char* expected = commandTable_[id].name;
+    for (size_t i = 0; i < name.length; ++i)
     {
-        handleNick(fd, params);
-        return;
+        if (expected[i] == '\0' || foldCommandChar(name.data[i]) != static_cast<unsigned char>(expected[i]))
+            return -1;
     }
-    else if (command == "USER")
+    return expected[name.length] == '\0' ? id : -1;
+}
+
+const CommandSpec& Server::commandSpec(int id)
+{
+    return commandTable_[id];
+}
+
+void Server::parseCommand(int fd, const MessageView& message)
+{
+    Client* client = getClientByFd(fd);
+    int id = findCommand(message.command);
+    // Charged up front: the handler may remove the client.
+    chargeFlood(client, id < 0 ? 1 : commandTable_[id].cost);
+    if (id >= 0)
+        ++stats_.commands[id].calls;
+
+    if (id < 0 || (commandTable_[id].needsRegistration && !client->isRegistered()))
     {
-        handleUser(fd, params);
+        if (!client->isRegistered())
+        {
+            sendNumeric(fd, NUMERIC(ERR_NOTREGISTERED), "*", "You have not registered");
+            return;
+        }
+
+        ++stats_.unknownCommands;
+        std::string command = message.command.str();
+        for (size_t i = 0; i < command.length(); ++i)
+        {
+            command[i] = foldCommandChar(command[i]);
+        }
+        sendNumeric(fd, NUMERIC(ERR_UNKNOWNCOMMAND), client->getNickname(), command,
+                    "Unknown command");
         return;
     }
-    
-    if (!client->isRegistered())
+
+    const CommandSpec& spec = commandTable_[id];
+    if (message.paramCount < spec.minParams)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOTREGISTERED + " * :You have not registered\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NEEDMOREPARAMS), client->getNickname(), spec.name,
+                    "Not enough parameters");
         return;
     }
-    
-    if (command == "JOIN")
-        handleJoin(fd, params);
-    else if (command == "PRIVMSG")
-        handlePrivmsg(fd, params);
-    else if (command == "KICK")
-        handleKick(fd, params);
-    else if (command == "INVITE")
-        handleInvite(fd, params);
-    else if (command == "TOPIC")
-        handleTopic(fd, params);
-    else if (command == "MODE")
-        handleMode(fd, params);
-    else if (command == "PART")
-        handlePart(fd, params);
-    else if (command == "QUIT")
-        handleQuit(fd, params);
-    else if (command == "WHO")
-        handleWho(fd, params);
-    else
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_UNKNOWNCOMMAND + " " + 
-                     client->getNickname() + " " + command + " :Unknown command\r\n");
-    }
+
+    // The handlers take std::string parameters; message_ keeps their
+    // storage from line to line instead of building fresh vectors.
+    message_.assign(message);
+
+    // currentCommand_ lets sendToClient book the lines the handler sends.
+    currentCommand_ = id;
+    unsigned long long start = Utils::monotonicNanos();
+    (this->*spec.handler)(fd, message_.params);
+    unsigned long long elapsed = Utils::monotonicNanos() - start;
+    currentCommand_ = -1;
+
+    CommandStats& stats = stats_.commands[id];
+    ++stats.runs;
+    stats.totalNanos += elapsed;
+    if (elapsed > stats.maxNanos)
+        stats.maxNanos = elapsed;
+    stats.latency.record(elapsed);
 }
 
 void Server::handlePass(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
+    Client* client = getClientByFd(fd);
     
     if (client->isRegistered())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_ALREADYREGISTERED + 
-                     " " + client->getNickname() + " :You may not reregister\r\n");
+        sendNumeric(fd, NUMERIC(ERR_ALREADYREGISTERED), client->getNickname(),
+                    "You may not reregister");
         return;
     }
     
     if (params.empty())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " * PASS :Not enough parameters\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NEEDMOREPARAMS), "*", "PASS", "Not enough parameters");
         return;
     }
     
@@ -84,26 +158,23 @@ void Server::handlePass(int fd, const std::vector<std::string>& params)
     }
     else
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_PASSWDMISMATCH + 
-                     " * :Password incorrect\r\n");
+        sendNumeric(fd, NUMERIC(ERR_PASSWDMISMATCH), "*", "Password incorrect");
     }
 }
 
 void Server::handleNick(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
+    Client* client = getClientByFd(fd);
     
     if (!client->hasPassOk())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_PASSWDMISMATCH + 
-                     " * :Password required\r\n");
+        sendNumeric(fd, NUMERIC(ERR_PASSWDMISMATCH), "*", "Password required");
         return;
     }
     
     if (params.empty())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NONICKNAMEGIVEN + 
-                     " * :No nickname given\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NONICKNAMEGIVEN), "*", "No nickname given");
         return;
     }
     
@@ -111,16 +182,14 @@ void Server::handleNick(int fd, const std::vector<std::string>& params)
     
     if (!Utils::isValidNickname(newNick))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_ERRONEUSNICKNAME + 
-                     " * " + newNick + " :Erroneous nickname\r\n");
+        sendNumeric(fd, NUMERIC(ERR_ERRONEUSNICKNAME), "*", newNick, "Erroneous nickname");
         return;
     }
     
     Client* existingClient = getClientByNick(newNick);
     if (existingClient && existingClient->getFd() != fd)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NICKNAMEINUSE + 
-                     " * " + newNick + " :Nickname is already in use\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NICKNAMEINUSE), "*", newNick, "Nickname is already in use");
         return;
     }
     
@@ -131,18 +200,12 @@ void Server::handleNick(int fd, const std::vector<std::string>& params)
         std::string nickChangeMsg = ":" + client->getPrefix() + " NICK :" + newNick + "\r\n";
         
         sendToClient(fd, nickChangeMsg);
-        
-        std::set<std::string> channels = client->getChannels();
-        for (std::set<std::string>::iterator it = channels.begin(); it != channels.end(); ++it)
-        {
-            Channel* channel = getChannel(*it);
-            if (channel)
-            {
-                sendToChannel(channel, nickChangeMsg, fd);
-            }
-        }
+        sendToCommonChannels(client, nickChangeMsg);
     }
     
+    if (oldNick != "*")
+        nicks_.erase(oldNick);
+    nicks_.insert(newNick, fd);
     client->setNickname(newNick);
     
     if (!client->isRegistered() && client->hasPassOk() && 
@@ -150,42 +213,32 @@ void Server::handleNick(int fd, const std::vector<std::string>& params)
     {
         client->setRegistered(true);
         client->setAuthenticated(true);
+        timersOf(fd).schedule(&client->getTimer(), tick_ + PING_INTERVAL);
         
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_WELCOME + " " + 
-                     client->getNickname() + " :Welcome to the Internet Relay Network " + 
-                     client->getPrefix() + "\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_YOURHOST + " " + 
-                     client->getNickname() + " :Your host is " + SERVER_NAME + 
-                     ", running version 1.0\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_CREATED + " " + 
-                     client->getNickname() + " :This server was created today\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_MYINFO + " " + 
-                     client->getNickname() + " " + SERVER_NAME + " 1.0 o itkol\r\n");
+        sendWelcome(fd, client);
     }
 }
 
 void Server::handleUser(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
+    Client* client = getClientByFd(fd);
     
     if (!client->hasPassOk())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_PASSWDMISMATCH + 
-                     " * :Password required\r\n");
+        sendNumeric(fd, NUMERIC(ERR_PASSWDMISMATCH), "*", "Password required");
         return;
     }
     
     if (client->isRegistered())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_ALREADYREGISTERED + 
-                     " " + client->getNickname() + " :You may not reregister\r\n");
+        sendNumeric(fd, NUMERIC(ERR_ALREADYREGISTERED), client->getNickname(),
+                    "You may not reregister");
         return;
     }
     
     if (params.size() < 4)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " * USER :Not enough parameters\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NEEDMOREPARAMS), "*", "USER", "Not enough parameters");
         return;
     }
     
@@ -197,30 +250,35 @@ void Server::handleUser(int fd, const std::vector<std::string>& params)
     {
         client->setRegistered(true);
         client->setAuthenticated(true);
+        timersOf(fd).schedule(&client->getTimer(), tick_ + PING_INTERVAL);
         
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_WELCOME + " " + 
-                     client->getNickname() + " :Welcome to the Internet Relay Network " + 
-                     client->getPrefix() + "\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_YOURHOST + " " + 
-                     client->getNickname() + " :Your host is " + SERVER_NAME + 
-                     ", running version 1.0\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_CREATED + " " + 
-                     client->getNickname() + " :This server was created today\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_MYINFO + " " + 
-                     client->getNickname() + " " + SERVER_NAME + " 1.0 o itkol\r\n");
+        sendWelcome(fd, client);
     }
 }
 
+void Server::sendWelcome(int fd, Client* client)
+{
+    std::string nick = client->getNickname();
+
+    Reply welcome(NUMERIC(RPL_WELCOME));
+    welcome.param(nick).trailing("Welcome to the Internet Relay Network ").append(client->getPrefix());
+    sendReply(fd, welcome);
+
+    sendNumeric(fd, NUMERIC(RPL_YOURHOST), nick,
+                "Your host is " SERVER_NAME ", running version 1.0");
+    sendNumeric(fd, NUMERIC(RPL_CREATED), nick, "This server was created today");
+
+    Reply info(NUMERIC(RPL_MYINFO));
+    info.param(nick).param(SERVER_NAME " 1.0 o itkol");
+    sendReply(fd, info);
+
+    sendNumeric(fd, NUMERIC(RPL_ISUPPORT), nick, "CASEMAPPING=rfc1459", "CHANTYPES=#&",
+                "are supported by this server");
+}
+
 void Server::handleJoin(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
-    
-    if (params.empty())
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " " + client->getNickname() + " JOIN :Not enough parameters\r\n");
-        return;
-    }
+    Client* client = getClientByFd(fd);
     
     std::vector<std::string> channelNames = Utils::split(params[0], ',');
     std::vector<std::string> keys;
@@ -236,12 +294,11 @@ void Server::handleJoin(int fd, const std::vector<std::string>& params)
         
         if (!Utils::isValidChannelName(channelName))
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                         " " + client->getNickname() + " " + channelName + " :No such channel\r\n");
+            sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), channelName,
+                        "No such channel");
             continue;
         }
         
-        std::string lowerName = Utils::toLower(channelName);
         Channel* channel = getChannel(channelName);
         
         if (channel)
@@ -249,30 +306,30 @@ void Server::handleJoin(int fd, const std::vector<std::string>& params)
             if (channel->hasClient(fd))
                 continue;
             
-            if (channel->isInviteOnly() && !client->isInvited(lowerName))
+            if (channel->isInviteOnly() && !client->isInvited(channel->getAtom(), tick_))
             {
-                sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_INVITEONLYCHAN + 
-                             " " + client->getNickname() + " " + channelName + " :Cannot join channel (+i)\r\n");
+                sendNumeric(fd, NUMERIC(ERR_INVITEONLYCHAN), client->getNickname(), channelName,
+                            "Cannot join channel (+i)");
                 continue;
             }
             
             if (channel->hasKey() && channel->getKey() != key)
             {
-                sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_BADCHANNELKEY + 
-                             " " + client->getNickname() + " " + channelName + " :Cannot join channel (+k)\r\n");
+                sendNumeric(fd, NUMERIC(ERR_BADCHANNELKEY), client->getNickname(), channelName,
+                            "Cannot join channel (+k)");
                 continue;
             }
             
             if (channel->hasLimit() && channel->getClientCount() >= channel->getUserLimit())
             {
-                sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_CHANNELISFULL + 
-                             " " + client->getNickname() + " " + channelName + " :Cannot join channel (+l)\r\n");
+                sendNumeric(fd, NUMERIC(ERR_CHANNELISFULL), client->getNickname(), channelName,
+                            "Cannot join channel (+l)");
                 continue;
             }
             
-            channel->addClient(fd);
-            client->addChannel(lowerName);
-            client->removeInvite(lowerName);
+            joinChannel(client, channel, 0);
+            if (client->removeInvite(channel->getAtom()))
+                atoms_.release(channel->getAtom());
         }
         else
         {
@@ -284,103 +341,106 @@ void Server::handleJoin(int fd, const std::vector<std::string>& params)
         
         if (!channel->getTopic().empty())
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_TOPIC + " " + 
-                         client->getNickname() + " " + channel->getName() + " :" + channel->getTopic() + "\r\n");
+            sendNumeric(fd, NUMERIC(RPL_TOPIC), client->getNickname(), channel->getName(),
+                        channel->getTopic());
         }
         else
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_NOTOPIC + " " + 
-                         client->getNickname() + " " + channel->getName() + " :No topic is set\r\n");
+            sendNumeric(fd, NUMERIC(RPL_NOTOPIC), client->getNickname(), channel->getName(),
+                        "No topic is set");
         }
         
-        std::string namesList;
-        std::set<int> clients = channel->getClients();
-        for (std::set<int>::iterator it = clients.begin(); it != clients.end(); ++it)
+        // RPL_NAMREPLY is split across lines once the names outgrow one.
+        Reply names(NUMERIC(RPL_NAMREPLY));
+        names.param(client->getNickname()).param("=").param(channel->getName()).trailing("");
+        size_t header = names.size();
+        const std::vector<Membership*>& members = channel->getMembers();
+        for (size_t i = 0; i < members.size(); ++i)
         {
-            Client* member = getClientByFd(*it);
-            if (member)
+            Client* member = members[i]->client;
+            std::string memberNick = member->getNickname();
+            bool op = (members[i]->flags & MEMBER_OPERATOR) != 0;
+            if (names.size() > header && !names.fits(1 + op + memberNick.size()))
             {
-                if (!namesList.empty())
-                    namesList += " ";
-                if (channel->isOperator(*it))
-                    namesList += "@";
-                namesList += member->getNickname();
+                sendReply(fd, names);
+                names.truncate(header);
             }
+            if (names.size() > header)
+                names.append(" ");
+            if (op)
+                names.append("@");
+            names.append(memberNick);
         }
-        
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_NAMREPLY + " " + 
-                     client->getNickname() + " = " + channel->getName() + " :" + namesList + "\r\n");
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_ENDOFNAMES + " " + 
-                     client->getNickname() + " " + channel->getName() + " :End of /NAMES list\r\n");
+        sendReply(fd, names);
+        sendNumeric(fd, NUMERIC(RPL_ENDOFNAMES), client->getNickname(), channel->getName(),
+                    "End of /NAMES list");
     }
 }
 
 void Server::handlePrivmsg(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
+    Client* client = getClientByFd(fd);
     
     if (params.empty())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NORECIPIENT + 
-                     " " + client->getNickname() + " :No recipient given (PRIVMSG)\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NORECIPIENT), client->getNickname(),
+                    "No recipient given (PRIVMSG)");
         return;
     }
     
     if (params.size() < 2)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOTEXTTOSEND + 
-                     " " + client->getNickname() + " :No text to send\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOTEXTTOSEND), client->getNickname(), "No text to send");
         return;
     }
     
-    std::string target = params[0];
-    std::string message = params[1];
+    const std::string& target = params[0];
+    
+    // Relayed lines are rendered in place like numerics; the only heap
+    // allocation per message is the shared buffer every recipient queues.
+    Reply privmsg(":");
+    privmsg.append(client->getPrefix()).append(" PRIVMSG ").param(target).trailing(params[1]);
     
     if (target[0] == '#' || target[0] == '&')
     {
         Channel* channel = getChannel(target);
         if (!channel)
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                         " " + client->getNickname() + " " + target + " :No such channel\r\n");
+            sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), target,
+                        "No such channel");
             return;
         }
         
         if (!channel->hasClient(fd))
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_CANNOTSENDTOCHAN + 
-                         " " + client->getNickname() + " " + target + " :Cannot send to channel\r\n");
+            sendNumeric(fd, NUMERIC(ERR_CANNOTSENDTOCHAN), client->getNickname(), target,
+                        "Cannot send to channel");
             return;
         }
         
-        std::string privmsg = ":" + client->getPrefix() + " PRIVMSG " + target + " :" + message + "\r\n";
-        sendToChannel(channel, privmsg, fd);
+        // Fanout to a big channel is charged by its size.
+        chargeFlood(client, static_cast<unsigned>(channel->getClientCount() / FLOOD_FANOUT_MEMBERS));
+        SharedBuffer* buffer = SharedBuffer::create(privmsg.finish(), privmsg.finishedSize());
+        sendToChannel(channel, buffer, fd, SEND_BULK);
+        buffer->release();
     }
     else
     {
         Client* targetClient = getClientByNick(target);
         if (!targetClient)
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHNICK + 
-                         " " + client->getNickname() + " " + target + " :No such nick/channel\r\n");
+            sendNumeric(fd, NUMERIC(ERR_NOSUCHNICK), client->getNickname(), target,
+                        "No such nick/channel");
             return;
         }
         
-        std::string privmsg = ":" + client->getPrefix() + " PRIVMSG " + target + " :" + message + "\r\n";
-        sendToClient(targetClient->getFd(), privmsg);
+        sendReply(targetClient->getFd(), privmsg);
     }
 }
 
 void Server::handleKick(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
-    
-    if (params.size() < 2)
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " " + client->getNickname() + " KICK :Not enough parameters\r\n");
-        return;
-    }
+    Client* client = getClientByFd(fd);
     
     std::string channelName = params[0];
     std::string targetNick = params[1];
@@ -389,57 +449,43 @@ void Server::handleKick(int fd, const std::vector<std::string>& params)
     Channel* channel = getChannel(channelName);
     if (!channel)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                     " " + client->getNickname() + " " + channelName + " :No such channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), channelName,
+                    "No such channel");
         return;
     }
     
     if (!channel->hasClient(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOTONCHANNEL + 
-                     " " + client->getNickname() + " " + channelName + " :You're not on that channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOTONCHANNEL), client->getNickname(), channelName,
+                    "You're not on that channel");
         return;
     }
     
     if (!channel->isOperator(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_CHANOPRIVSNEEDED + 
-                     " " + client->getNickname() + " " + channelName + " :You're not channel operator\r\n");
+        sendNumeric(fd, NUMERIC(ERR_CHANOPRIVSNEEDED), client->getNickname(), channelName,
+                    "You're not channel operator");
         return;
     }
     
     Client* targetClient = getClientByNick(targetNick);
-    if (!targetClient || !channel->hasClient(targetClient->getFd()))
+    Membership* target = targetClient ? channel->findMember(targetClient->getFd()) : NULL;
+    if (!target)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_USERNOTINCHANNEL + 
-                     " " + client->getNickname() + " " + targetNick + " " + channelName + 
-                     " :They aren't on that channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_USERNOTINCHANNEL), client->getNickname(), targetNick, channelName,
+                    "They aren't on that channel");
         return;
     }
     
     std::string kickMsg = ":" + client->getPrefix() + " KICK " + channel->getName() + 
                           " " + targetClient->getNickname() + " :" + reason + "\r\n";
     sendToChannel(channel, kickMsg);
-    
-    channel->removeClient(targetClient->getFd());
-    targetClient->removeChannel(Utils::toLower(channelName));
-    
-    if (channel->isEmpty())
-    {
-        removeChannel(channelName);
-    }
+    leaveChannel(target);
 }
 
 void Server::handleInvite(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
-    
-    if (params.size() < 2)
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " " + client->getNickname() + " INVITE :Not enough parameters\r\n");
-        return;
-    }
+    Client* client = getClientByFd(fd);
     
     std::string targetNick = params[0];
     std::string channelName = params[1];
@@ -447,45 +493,46 @@ void Server::handleInvite(int fd, const std::vector<std::string>& params)
     Client* targetClient = getClientByNick(targetNick);
     if (!targetClient)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHNICK + 
-                     " " + client->getNickname() + " " + targetNick + " :No such nick/channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOSUCHNICK), client->getNickname(), targetNick,
+                    "No such nick/channel");
         return;
     }
     
     Channel* channel = getChannel(channelName);
     if (!channel)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                     " " + client->getNickname() + " " + channelName + " :No such channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), channelName,
+                    "No such channel");
         return;
     }
     
     if (!channel->hasClient(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOTONCHANNEL + 
-                     " " + client->getNickname() + " " + channelName + " :You're not on that channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOTONCHANNEL), client->getNickname(), channelName,
+                    "You're not on that channel");
         return;
     }
     
     if (channel->isInviteOnly() && !channel->isOperator(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_CHANOPRIVSNEEDED + 
-                     " " + client->getNickname() + " " + channelName + " :You're not channel operator\r\n");
+        sendNumeric(fd, NUMERIC(ERR_CHANOPRIVSNEEDED), client->getNickname(), channelName,
+                    "You're not channel operator");
         return;
     }
     
     if (channel->hasClient(targetClient->getFd()))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_USERONCHANNEL + 
-                     " " + client->getNickname() + " " + targetNick + " " + channelName + 
-                     " :is already on channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_USERONCHANNEL), client->getNickname(), targetNick, channelName,
+                    "is already on channel");
         return;
     }
     
-    targetClient->addInvite(Utils::toLower(channelName));
+    if (targetClient->addInvite(channel->getAtom(), tick_ + INVITE_TIMEOUT))
+        atoms_.retain(channel->getAtom());
     
-    sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_INVITING + " " + 
-                 client->getNickname() + " " + targetNick + " " + channelName + "\r\n");
+    Reply inviting(NUMERIC(RPL_INVITING));
+    inviting.param(client->getNickname()).param(targetNick).param(channelName);
+    sendReply(fd, inviting);
     
     sendToClient(targetClient->getFd(), ":" + client->getPrefix() + " INVITE " + 
                  targetNick + " " + channelName + "\r\n");
@@ -493,29 +540,22 @@ void Server::handleInvite(int fd, const std::vector<std::string>& params)
 
 void Server::handleTopic(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
-    
-    if (params.empty())
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " " + client->getNickname() + " TOPIC :Not enough parameters\r\n");
-        return;
-    }
+    Client* client = getClientByFd(fd);
     
     std::string channelName = params[0];
     Channel* channel = getChannel(channelName);
     
     if (!channel)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                     " " + client->getNickname() + " " + channelName + " :No such channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), channelName,
+                    "No such channel");
         return;
     }
     
     if (!channel->hasClient(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOTONCHANNEL + 
-                     " " + client->getNickname() + " " + channelName + " :You're not on that channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOTONCHANNEL), client->getNickname(), channelName,
+                    "You're not on that channel");
         return;
     }
     
@@ -523,21 +563,21 @@ void Server::handleTopic(int fd, const std::vector<std::string>& params)
     {
         if (channel->getTopic().empty())
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_NOTOPIC + " " + 
-                         client->getNickname() + " " + channelName + " :No topic is set\r\n");
+            sendNumeric(fd, NUMERIC(RPL_NOTOPIC), client->getNickname(), channelName,
+                        "No topic is set");
         }
         else
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_TOPIC + " " + 
-                         client->getNickname() + " " + channelName + " :" + channel->getTopic() + "\r\n");
+            sendNumeric(fd, NUMERIC(RPL_TOPIC), client->getNickname(), channelName,
+                        channel->getTopic());
         }
         return;
     }
     
     if (channel->isTopicRestricted() && !channel->isOperator(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_CHANOPRIVSNEEDED + 
-                     " " + client->getNickname() + " " + channelName + " :You're not channel operator\r\n");
+        sendNumeric(fd, NUMERIC(ERR_CHANOPRIVSNEEDED), client->getNickname(), channelName,
+                    "You're not channel operator");
         return;
     }
     
@@ -550,14 +590,7 @@ void Server::handleTopic(int fd, const std::vector<std::string>& params)
 
 void Server::handleMode(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
-    
-    if (params.empty())
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " " + client->getNickname() + " MODE :Not enough parameters\r\n");
-        return;
-    }
+    Client* client = getClientByFd(fd);
     
     std::string target = params[0];
     
@@ -565,8 +598,9 @@ void Server::handleMode(int fd, const std::vector<std::string>& params)
     {
         if (params.size() == 1)
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " 221 " + 
-                         client->getNickname() + " +\r\n");
+            Reply modes(NUMERIC(RPL_UMODEIS));
+            modes.param(client->getNickname()).param("+");
+            sendReply(fd, modes);
         }
         return;
     }
@@ -574,23 +608,23 @@ void Server::handleMode(int fd, const std::vector<std::string>& params)
     Channel* channel = getChannel(target);
     if (!channel)
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                     " " + client->getNickname() + " " + target + " :No such channel\r\n");
+        sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), target,
+                    "No such channel");
         return;
     }
     
     if (params.size() == 1)
     {
-        std::string modeString = channel->getModeString();
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_CHANNELMODEIS + " " + 
-                     client->getNickname() + " " + channel->getName() + " " + modeString + "\r\n");
+        Reply modes(NUMERIC(RPL_CHANNELMODEIS));
+        modes.param(client->getNickname()).param(channel->getName()).param(channel->getModeString());
+        sendReply(fd, modes);
         return;
     }
     
     if (!channel->isOperator(fd))
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_CHANOPRIVSNEEDED + 
-                     " " + client->getNickname() + " " + channel->getName() + " :You're not channel operator\r\n");
+        sendNumeric(fd, NUMERIC(ERR_CHANOPRIVSNEEDED), client->getNickname(), channel->getName(),
+                    "You're not channel operator");
         return;
     }
     
@@ -631,8 +665,8 @@ void Server::handleMode(int fd, const std::vector<std::string>& params)
             }
             else if (adding)
             {
-                sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                             " " + client->getNickname() + " MODE :Not enough parameters\r\n");
+                sendNumeric(fd, NUMERIC(ERR_NEEDMOREPARAMS), client->getNickname(), "MODE",
+                            "Not enough parameters");
                 continue;
             }
             handleModeK(channel, client, adding, key);
@@ -657,8 +691,8 @@ void Server::handleMode(int fd, const std::vector<std::string>& params)
             }
             else
             {
-                sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                             " " + client->getNickname() + " MODE :Not enough parameters\r\n");
+                sendNumeric(fd, NUMERIC(ERR_NEEDMOREPARAMS), client->getNickname(), "MODE",
+                            "Not enough parameters");
             }
         }
         else if (c == 'l')
@@ -672,8 +706,8 @@ void Server::handleMode(int fd, const std::vector<std::string>& params)
                 }
                 else
                 {
-                    sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                                 " " + client->getNickname() + " MODE :Not enough parameters\r\n");
+                    sendNumeric(fd, NUMERIC(ERR_NEEDMOREPARAMS), client->getNickname(), "MODE",
+                                "Not enough parameters");
                     continue;
                 }
             }
@@ -731,9 +765,8 @@ void Server::handleModeO(Channel* channel, Client* client, bool adding, const st
     Client* targetClient = getClientByNick(targetNick);
     if (!targetClient || !channel->hasClient(targetClient->getFd()))
     {
-        sendToClient(client->getFd(), ":" + std::string(SERVER_NAME) + " " + ERR_USERNOTINCHANNEL + 
-                     " " + client->getNickname() + " " + targetNick + " " + channel->getName() + 
-                     " :They aren't on that channel\r\n");
+        sendNumeric(client->getFd(), NUMERIC(ERR_USERNOTINCHANNEL), client->getNickname(), targetNick,
+                    channel->getName(), "They aren't on that channel");
         return;
     }
     
@@ -768,14 +801,7 @@ void Server::handleModeL(Channel* channel, Client* client, bool adding, const st
 
 void Server::handlePart(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
-    
-    if (params.empty())
-    {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NEEDMOREPARAMS + 
-                     " " + client->getNickname() + " PART :Not enough parameters\r\n");
-        return;
-    }
+    Client* client = getClientByFd(fd);
     
     std::vector<std::string> channelNames = Utils::split(params[0], ',');
     std::string reason = (params.size() > 1) ? params[1] : "";
@@ -787,15 +813,16 @@ void Server::handlePart(int fd, const std::vector<std::string>& params)
         
         if (!channel)
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOSUCHCHANNEL + 
-                         " " + client->getNickname() + " " + channelName + " :No such channel\r\n");
+            sendNumeric(fd, NUMERIC(ERR_NOSUCHCHANNEL), client->getNickname(), channelName,
+                        "No such channel");
             continue;
         }
         
-        if (!channel->hasClient(fd))
+        Membership* membership = channel->findMember(fd);
+        if (!membership)
         {
-            sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + ERR_NOTONCHANNEL + 
-                         " " + client->getNickname() + " " + channelName + " :You're not on that channel\r\n");
+            sendNumeric(fd, NUMERIC(ERR_NOTONCHANNEL), client->getNickname(), channelName,
+                        "You're not on that channel");
             continue;
         }
         
@@ -804,44 +831,23 @@ void Server::handlePart(int fd, const std::vector<std::string>& params)
             partMsg += " :" + reason;
         partMsg += "\r\n";
         sendToChannel(channel, partMsg);
-        
-        channel->removeClient(fd);
-        client->removeChannel(Utils::toLower(channelName));
-        
-        if (channel->isEmpty())
-        {
-            removeChannel(channelName);
-        }
+        leaveChannel(membership);
     }
 }
 
 void Server::handleQuit(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
     std::string reason = (params.empty()) ? "Client quit" : params[0];
-    
-    std::set<std::string> channels = client->getChannels();
-    for (std::set<std::string>::iterator it = channels.begin(); it != channels.end(); ++it)
-    {
-        Channel* channel = getChannel(*it);
-        if (channel)
-        {
-            std::string quitMsg = ":" + client->getPrefix() + " QUIT :" + reason + "\r\n";
-            sendToChannel(channel, quitMsg, fd);
-        }
-    }
-    
-    removeClient(fd);
+    removeClient(fd, reason);
 }
 
 void Server::handleWho(int fd, const std::vector<std::string>& params)
 {
-    Client* client = clients_[fd];
+    Client* client = getClientByFd(fd);
     
     if (params.empty())
     {
-        sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_ENDOFWHO + " " + 
-                     client->getNickname() + " * :End of /WHO list\r\n");
+        sendNumeric(fd, NUMERIC(RPL_ENDOFWHO), client->getNickname(), "*", "End of /WHO list");
         return;
     }
     
@@ -852,26 +858,212 @@ void Server::handleWho(int fd, const std::vector<std::string>& params)
         Channel* channel = getChannel(target);
         if (channel)
         {
-            std::set<int> clients = channel->getClients();
-            for (std::set<int>::iterator it = clients.begin(); it != clients.end(); ++it)
+            std::string nick = client->getNickname();
+            std::string channelName = channel->getName();
+            const std::vector<Membership*>& members = channel->getMembers();
+            for (size_t i = 0; i < members.size(); ++i)
             {
-                Client* member = getClientByFd(*it);
-                if (member)
-                {
-                    std::string flags = "H";
-                    if (channel->isOperator(*it))
-                        flags += "@";
-                    
-                    sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_WHOREPLY + " " + 
-                                 client->getNickname() + " " + channel->getName() + " " + 
-                                 member->getUsername() + " " + member->getHostname() + " " + 
-                                 std::string(SERVER_NAME) + " " + member->getNickname() + " " + 
-                                 flags + " :0 " + member->getRealname() + "\r\n");
-                }
+                Client* member = members[i]->client;
+                Reply who(NUMERIC(RPL_WHOREPLY));
+                who.param(nick).param(channelName).param(member->getUsername())
+                   .param(member->getHostname()).param(SERVER_NAME).param(member->getNickname())
+                   .param((members[i]->flags & MEMBER_OPERATOR) ? "H@" : "H")
+                   .trailing("0 ").append(member->getRealname());
+                sendReply(fd, who);
             }
         }
     }
     
-    sendToClient(fd, ":" + std::string(SERVER_NAME) + " " + RPL_ENDOFWHO + " " + 
-                 client->getNickname() + " " + target + " :End of /WHO list\r\n");
+    sendNumeric(fd, NUMERIC(RPL_ENDOFWHO), client->getNickname(), target, "End of /WHO list");
+}
+
+void Server::handlePing(int fd, const std::vector<std::string>& params)
+{
+    Client* client = getClientByFd(fd);
+    
+    if (params.empty())
+    {
+        sendNumeric(fd, NUMERIC(ERR_NOORIGIN), client->getNickname(), "No origin specified");
+        return;
+    }
+    
+    Reply pong(":" SERVER_NAME " PONG ");
+    pong.param(SERVER_NAME).trailing(params[0]);
+    sendReply(fd, pong);
+}
+
+// Any line counts as activity for the keepalive timer; a PONG to our own
+// PING also yields the client's round-trip time.
+void Server::handlePong(int fd, const std::vector<std::string>& params)
+{
+    (void)params;
+    Client* client = getClientByFd(fd);
+    
+    long rtt = client->notePong(Utils::monotonicNanos());
+    if (rtt < 0)
+        return;
+    ++stats_.pongs;
+    stats_.rttTotalMillis += rtt;
+    if (static_cast<unsigned long>(rtt) > stats_.rttMaxMillis)
+        stats_.rttMaxMillis = rtt;
+}
+
+// OPER <name> <password>. The name is not checked: --oper-password is the
+// only credential, and OPER stays disabled when it is not set.
+void Server::handleOper(int fd, const std::vector<std::string>& params)
+{
+    Client* client = getClientByFd(fd);
+    const std::string& nick = client->getNickname();
+    
+    if (config_.operPassword.empty())
+    {
+        sendNumeric(fd, NUMERIC(ERR_NOOPERHOST), nick, "No O-lines for your host");
+        return;
+    }
+    
+    if (params[1] != config_.operPassword)
+    {
+        LOG(LOG_WARN, LOG_CLIENT) << "Failed OPER attempt from client " << fd;
+        sendNumeric(fd, NUMERIC(ERR_PASSWDMISMATCH), nick, "Password incorrect");
+        return;
+    }
+    
+    client->setIrcOperator(true);
+    LOG(LOG_INFO, LOG_CLIENT) << "Client " << fd << " (" << nick << ") is now an IRC operator";
+    sendNumeric(fd, NUMERIC(RPL_YOUREOPER), nick, "You are now an IRC operator");
+    sendToClient(fd, ":" + nick + " MODE " + nick + " :+o\r\n");
+}
+
+static std::string formatCount(unsigned long long value)
+{
+    std::ostringstream out;
+    out << value;
+    return out.str();
+}
+
+static std::string formatPool(const PoolStats& pool)
+{
+    std::ostringstream out;
+    out << pool.inUse << "/" << pool.peak;
+    return out.str();
+}
+
+// STATS <query>, for IRC operators:
+//   u  uptime and connection counts
+//   m  messages received and sent per command
+//   p  handler latency per command: count, mean, p50, p99, max
+//   t  traffic, SendQ drops, flood control, keepalive, pools, logging
+//   r  last keepalive round trip of each registered client
+// Everything reported is a counter the server keeps anyway, updated with
+// plain increments under the state lock, so STATS only formats them.
+void Server::handleStats(int fd, const std::vector<std::string>& params)
+{
+    Client* client = getClientByFd(fd);
+    const std::string& nick = client->getNickname();
+    
+    if (!client->isIrcOperator())
+    {
+        sendNumeric(fd, NUMERIC(ERR_NOPRIVILEGES), nick,
+                    "Permission Denied- You're not an IRC operator");
+        return;
+    }
+    
+    std::string query = params[0].empty() ? "*" : params[0].substr(0, 1);
+    
+    if (query == "u")
+    {
+        unsigned long long seconds = (Utils::monotonicNanos() - startNanos_) / 1000000000ULL;
+        std::ostringstream uptime;
+        uptime << "Server Up " << seconds / 86400 << " days " << (seconds / 3600) % 24 << ":"
+               << std::setfill('0') << std::setw(2) << (seconds / 60) % 60 << ":"
+               << std::setw(2) << seconds % 60;
+        sendNumeric(fd, NUMERIC(RPL_STATSUPTIME), nick, uptime.str());
+        
+        std::ostringstream connections;
+        connections << "Current connections: " << stats_.clients << " (peak " << stats_.peakClients
+                    << "), channels: " << stats_.channelPool.inUse;
+        sendNumeric(fd, NUMERIC(RPL_STATSCONN), nick, connections.str());
+    }
+    else if (query == "m")
+    {
+        for (int id = 0; id < COMMAND_COUNT; ++id)
+        {
+            const CommandStats& stats = stats_.commands[id];
+            if (stats.calls == 0)
+                continue;
+            sendNumeric(fd, NUMERIC(RPL_STATSCOMMANDS), nick, commandTable_[id].name,
+                        formatCount(stats.calls), formatCount(stats.messagesOut));
+        }
+    }
+    else if (query == "p")
+    {
+        for (int id = 0; id < COMMAND_COUNT; ++id)
+        {
+            const CommandStats& stats = stats_.commands[id];
+            if (stats.runs == 0)
+                continue;
+            std::ostringstream line;
+            line << commandTable_[id].name << " calls=" << stats.calls << " runs=" << stats.runs
+                 << " mean=" << stats.totalNanos / stats.runs << "ns"
+                 << " p50=" << stats.latency.percentile(stats.runs, 0.50, stats.maxNanos) << "ns"
+                 << " p99=" << stats.latency.percentile(stats.runs, 0.99, stats.maxNanos) << "ns"
+                 << " max=" << stats.maxNanos << "ns";
+            sendNumeric(fd, NUMERIC(RPL_STATSDEBUG), nick, line.str());
+        }
+    }
+    else if (query == "t")
+    {
+        std::vector<std::string> lines;
+        std::ostringstream line;
+        
+        line << "bytes in=" << stats_.recvBytes << " (" << stats_.recvCalls << " recvs, "
+             << (stats_.recvCalls ? stats_.recvBytes / stats_.recvCalls : 0) << " per recv) out="
+             << stats_.sendBytes << " (" << stats_.sendCalls << " sends)";
+        lines.push_back(line.str());
+        line.str("");
+        line << "messages in=" << stats_.messagesIn << " out=" << stats_.messagesOut
+             << " unknown commands=" << stats_.unknownCommands;
+        lines.push_back(line.str());
+        line.str("");
+        line << "sendq disconnects=" << stats_.sendQueueDisconnects << " drops=" << stats_.sendQueueDrops
+             << " dropped bytes=" << stats_.sendQueueDroppedBytes << " flood throttles=" << stats_.floodThrottles;
+        lines.push_back(line.str());
+        line.str("");
+        line << "keepalive pings=" << stats_.pingsSent << " pongs=" << stats_.pongs << " rtt mean="
+             << (stats_.pongs ? stats_.rttTotalMillis / stats_.pongs : 0) << "ms max=" << stats_.rttMaxMillis
+             << "ms ping timeouts=" << stats_.pingTimeouts << " registration timeouts="
+             << stats_.registrationTimeouts;
+        lines.push_back(line.str());
+        line.str("");
+        line << "pools in use/peak clients=" << formatPool(stats_.clientPool) << " channels="
+             << formatPool(stats_.channelPool) << " memberships=" << formatPool(stats_.membershipPool)
+             << " line buffers=" << formatPool(SharedBuffer::poolStats());
+        lines.push_back(line.str());
+        line.str("");
+        line << "log lines dropped=" << Log::dropped();
+        lines.push_back(line.str());
+        
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            sendNumeric(fd, NUMERIC(RPL_STATSDEBUG), nick, lines[i]);
+        }
+    }
+    else if (query == "r")
+    {
+        for (size_t i = 0; i < clients_.size(); ++i)
+        {
+            const Client* target = clients_[i].client;
+            if (!target || !target->isRegistered())
+                continue;
+            std::ostringstream line;
+            line << target->getNickname() << " rtt=";
+            if (target->getRttMillis() < 0)
+                line << "none";
+            else
+                line << target->getRttMillis() << "ms";
+            sendNumeric(fd, NUMERIC(RPL_STATSDEBUG), nick, line.str());
+        }
+    }
+    
+    sendNumeric(fd, NUMERIC(RPL_ENDOFSTATS), nick, query, "End of STATS report");
 }
@@ -0,0 +1,1156 @@
+#include "Server.hpp"
+#include "Uring.hpp"
+#include "Logger.hpp"
+
+// io_uring user_data: Client pointer (at least 8-byte aligned) with the
+// operation kind packed into its low bits.
+#define URING_OP_ACCEPT     1ULL
+#define URING_OP_RECV       2ULL
+#define URING_OP_SEND       3ULL
+#define URING_OP_WAKE       4ULL
+#define URING_OP_TIMER      5ULL
+#define URING_OP_CANCEL     6ULL
+#define URING_OP_MASK       7ULL
+#define URING_OP_SHIFT      3       // timeouts carry their deadline above the op
+
+ServerConfig::ServerConfig()
+#ifdef __linux__
+    : backend(BACKEND_EPOLL), threads(1),
+#else
+    : backend(BACKEND_POLL), threads(1),
+#endif
+    acceptBudget(DEFAULT_ACCEPT_BUDGET), sendQueueLimit(DEFAULT_SENDQ_LIMIT),
+    sendQueuePolicy(SENDQ_DISCONNECT), expectedClients(0),
+    floodRate(DEFAULT_FLOOD_RATE), floodBurst(DEFAULT_FLOOD_BURST)
+{
+}
+
+Reactor::Reactor(int id, Server* server)
+    : id(id), listenFd(-1), wakePending(false), epollFd(-1), uring(NULL),
+    timerDeadline(0), throttleWake(0), thread(pthread_self()), cpu(-1), server(server)
+{
+    wakeFds[0] = -1;
+    wakeFds[1] = -1;
+}
+
+bool Server::parseBackend(const std::string& name, IoBackend& backend)
+{
+    if (name == "poll")
+    {
+        backend = BACKEND_POLL;
+        return true;
+    }
+#ifdef __linux__
+    if (name == "epoll")
+    {
+        backend = BACKEND_EPOLL;
+        return true;
+    }
+#endif
+    if (name == "io_uring" || name == "uring")
+    {
+        backend = BACKEND_URING;
+        return true;
+    }
+    return false;
+}
+
+bool Server::parseCpuList(const std::string& list, std::vector<int>& cpus)
+{
+    std::vector<int> parsed;
+    size_t start = 0;
+
+    while (start <= list.length())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.length();
+
+        std::string item = list.substr(start, end - start);
+        if (item.empty() || item.length() > 4)
+            return false;
+        for (size_t i = 0; i < item.length(); ++i)
+        {
+            if (!std::isdigit(item[i]))
+                return false;
+        }
+        parsed.push_back(std::atoi(item.c_str()));
+        start = end + 1;
+    }
+
+    cpus = parsed;
+    return true;
+}
+
+bool Server::parseSendQueuePolicy(const std::string& name, SendQueuePolicy& policy)
+{
+    if (name == "disconnect")
+    {
+        policy = SENDQ_DISCONNECT;
+        return true;
+    }
+    if (name == "drop")
+    {
+        policy = SENDQ_DROP;
+        return true;
+    }
+    return false;
+}
+
+const char* Server::backendName(IoBackend backend)
+{
+    switch (backend)
+    {
+        case BACKEND_EPOLL:
+            return "epoll";
+        case BACKEND_URING:
+            return "io_uring";
+        case BACKEND_POLL:
+        default:
+            return "poll";
+    }
+}
+
+void Server::initReactor(Reactor& reactor)
+{
+    reactor.listenFd = createListenSocket();
+
+    if (pipe(reactor.wakeFds) == -1)
+    {
+        throw std::runtime_error("Failed to create wake pipe");
+    }
+    for (int i = 0; i < 2; ++i)
+    {
+        if (fcntl(reactor.wakeFds[i], F_SETFL, O_NONBLOCK) == -1
+            || fcntl(reactor.wakeFds[i], F_SETFD, FD_CLOEXEC) == -1)
+        {
+            throw std::runtime_error("Failed to set wake pipe to non-blocking");
+        }
+    }
+
+    struct pollfd listenPollFd;
+    listenPollFd.fd = reactor.listenFd;
+    listenPollFd.events = POLLIN;
+    listenPollFd.revents = 0;
+    reactor.pollFds.push_back(listenPollFd);
+
+    struct pollfd wakePollFd;
+    wakePollFd.fd = reactor.wakeFds[0];
+    wakePollFd.events = POLLIN;
+    wakePollFd.revents = 0;
+    reactor.pollFds.push_back(wakePollFd);
+
+    if (!config_.cpus.empty())
+        reactor.cpu = config_.cpus[reactor.id % config_.cpus.size()];
+
+    if (config_.backend == BACKEND_URING)
+    {
+        if (!initUring(reactor))
+            throw std::runtime_error("Failed to initialize io_uring");
+    }
+    else if (config_.backend == BACKEND_EPOLL)
+    {
+        initEpoll(reactor);
+    }
+}
+
+void Server::initEpoll(Reactor& reactor)
+{
+#ifdef __linux__
+    reactor.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor.epollFd == -1)
+    {
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+
+    // The listening socket and the wake pipe stay level-triggered so a
+    // single accept or drain per wakeup never strands pending work.
+    for (size_t i = REACTOR_LISTEN_SLOT; i < REACTOR_CLIENT_BASE; ++i)
+    {
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = reactor.pollFds[i].fd;
+        if (epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1)
+        {
+            throw std::runtime_error("Failed to register server socket with epoll");
+        }
+    }
+#else
+    (void)reactor;
+    throw std::runtime_error("epoll backend is not available on this platform");
+#endif
+}
+
+bool Server::initUring(Reactor& reactor)
+{
+#ifdef IRC_HAVE_IO_URING
+    Uring* uring = new Uring();
+    if (!uring->init(URING_ENTRIES) || !uring->initBufferRing())
+    {
+        delete uring;
+        return false;
+    }
+    reactor.uring = uring;
+    return true;
+#else
+    (void)reactor;
+    return false;
+#endif
+}
+
+void Server::closeReactor(Reactor& reactor)
+{
+#ifdef IRC_HAVE_IO_URING
+    delete reactor.uring;
+#endif
+    reactor.uring = NULL;
+
+    for (size_t i = 0; i < reactor.retiredClients.size(); ++i)
+    {
+        clientPool_.destroy(reactor.retiredClients[i]);
+    }
+    reactor.retiredClients.clear();
+    reactor.flushQueue.clear();
+
+    if (reactor.epollFd != -1)
+        close(reactor.epollFd);
+    if (reactor.listenFd != -1)
+        close(reactor.listenFd);
+    for (int i = 0; i < 2; ++i)
+    {
+        if (reactor.wakeFds[i] != -1)
+            close(reactor.wakeFds[i]);
+    }
+    reactor.epollFd = -1;
+    reactor.listenFd = -1;
+    reactor.wakeFds[0] = -1;
+    reactor.wakeFds[1] = -1;
+}
+
+void Server::run()
+{
+    startWorkers();
+    try
+    {
+        runReactor(*reactors_[0]);
+    }
+    catch (...)
+    {
+        requestShutdown();
+        stopWorkers();
+        throw;
+    }
+    stopWorkers();
+}
+
+void* Server::reactorThread(void* arg)
+{
+    Reactor* reactor = static_cast<Reactor*>(arg);
+    Server* server = reactor->server;
+
+    try
+    {
+        server->runReactor(*reactor);
+    }
+    catch (const std::exception& e)
+    {
+        // Take the whole server down rather than silently losing this
+        // reactor's clients; the main thread notices and joins everyone.
+        server->lockState();
+        LOG(LOG_ERROR, LOG_SERVER) << "Reactor " << reactor->id << " failed: " << e.what();
+        requestShutdown();
+        server->wakeReactor(*server->reactors_[0]);
+        server->unlockState();
+    }
+    return NULL;
+}
+
+void Server::startWorkers()
+{
+    if (reactors_.size() < 2)
+        return;
+
+    // Signals are delivered to the main thread (reactor 0) only; the workers
+    // inherit this mask and are stopped through their wake pipes instead.
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGQUIT);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    // Workers only read Reactor::thread under the state lock, so holding it
+    // here guarantees they see the id pthread_create stored.
+    lockState();
+    for (size_t i = 1; i < reactors_.size(); ++i)
+    {
+        if (pthread_create(&reactors_[i]->thread, NULL, reactorThread, reactors_[i]) != 0)
+        {
+            unlockState();
+            pthread_sigmask(SIG_SETMASK, &previous, NULL);
+            reactors_.resize(i);
+            requestShutdown();
+            stopWorkers();
+            throw std::runtime_error("Failed to start reactor thread");
+        }
+    }
+    unlockState();
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+void Server::stopWorkers()
+{
+    if (reactors_.size() < 2)
+        return;
+
+    lockState();
+    for (size_t i = 1; i < reactors_.size(); ++i)
+    {
+        wakeReactor(*reactors_[i]);
+    }
+    unlockState();
+
+    for (size_t i = 1; i < reactors_.size(); ++i)
+    {
+        pthread_join(reactors_[i]->thread, NULL);
+        reactors_[i]->thread = pthread_self();
+    }
+}
+
+void Server::pinReactor(Reactor& reactor)
+{
+    if (reactor.cpu < 0)
+        return;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int err = EINVAL;
+    if (reactor.cpu < CPU_SETSIZE)
+    {
+        CPU_SET(reactor.cpu, &set);
+        err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    if (err != 0)
+    {
+        lockState();
+        LOG(LOG_WARN, LOG_SERVER) << "Failed to pin reactor " << reactor.id << " to CPU " << reactor.cpu
+            << ": " << std::strerror(err);
+        unlockState();
+    }
+#endif
+}
+
+void Server::runReactor(Reactor& reactor)
+{
+    pinReactor(reactor);
+
+    if (config_.backend == BACKEND_URING)
+        runUring(reactor);
+    else if (config_.backend == BACKEND_EPOLL)
+        runEpoll(reactor);
+    else
+        runPoll(reactor);
+}
+
+// Must be called with the state lock held.
+void Server::wakeReactor(Reactor& reactor)
+{
+    if (reactor.wakePending)
+        return;
+    reactor.wakePending = true;
+
+    char byte = 0;
+    while (write(reactor.wakeFds[1], &byte, 1) == -1 && errno == EINTR)
+        ;
+}
+
+// Must be called with the state lock held.
+void Server::drainWake(Reactor& reactor)
+{
+    char buffer[64];
+    ssize_t n;
+    do
+    {
+        n = read(reactor.wakeFds[0], buffer, sizeof(buffer));
+    } while (n > 0 || (n == -1 && errno == EINTR));
+    reactor.wakePending = false;
+}
+
+// With a single reactor every handler already runs on one thread, so the
+// lock is skipped entirely.
+void Server::lockState()
+{
+    if (reactors_.size() > 1)
+        pthread_mutex_lock(&stateMutex_);
+}
+
+void Server::unlockState()
+{
+    if (reactors_.size() > 1)
+        pthread_mutex_unlock(&stateMutex_);
+}
+
+unsigned long Server::currentTick()
+{
+    return static_cast<unsigned long>(Utils::monotonicNanos() / (TIMER_TICK_MS * 1000000ULL));
+}
+
+// Runs once per loop iteration with the state lock held. Deadlines are
+// tick-granular, so most calls only read the clock.
+void Server::runTimers(Reactor& reactor)
+{
+    unsigned long now = currentTick();
+    if (now > tick_)
+        tick_ = now;
+    reactor.timers.advance(now);
+    TimerNode* node;
+    while ((node = reactor.timers.nextExpired()) != NULL)
+    {
+        handleTimer(static_cast<Client*>(node->owner));
+    }
+}
+
+// The wait timeout that wakes the loop at the next tick boundary or when
+// the first throttled client may go on, or -1 when there is neither.
+int Server::timerWaitMillis(Reactor& reactor)
+{
+    int timeout = -1;
+    if (!reactor.timers.empty())
+    {
+        unsigned long long millis = Utils::monotonicNanos() / 1000000ULL;
+        timeout = static_cast<int>(TIMER_TICK_MS - millis % TIMER_TICK_MS);
+    }
+    if (!reactor.throttled.empty())
+    {
+        unsigned long long now = currentMicros();
+        int wait = 0;
+        if (reactor.throttleWake > now)
+            wait = static_cast<int>((reactor.throttleWake - now + 999) / 1000);
+        if (timeout == -1 || wait < timeout)
+            timeout = wait;
+    }
+    return timeout;
+}
+
+TimerWheel& Server::timersOf(int fd)
+{
+    return reactors_[clients_[fd].reactor]->timers;
+}
+
+unsigned long long Server::currentMicros()
+{
+    return Utils::monotonicNanos() / 1000ULL;
+}
+
+// Flood control is a token bucket kept as a single clock per client: each
+// command pushes the clock forward by its cost, and the client may run up
+// to floodBurstMicros_ ahead of real time before it has to wait. An idle
+// client's clock is pulled up to now, which refills its bucket.
+bool Server::isFlooding(Client* client, unsigned long long now)
+{
+    if (!floodUnitMicros_)
+        return false;
+    unsigned long long clock = client->getFloodClock();
+    if (clock <= now)
+    {
+        client->setFloodClock(now);
+        return false;
+    }
+    return clock - now > floodBurstMicros_;
+}
+
+void Server::chargeFlood(Client* client, unsigned cost)
+{
+    if (floodUnitMicros_)
+        client->setFloodClock(client->getFloodClock() + cost * floodUnitMicros_);
+}
+
+// Parks a client that ran out of budget: its remaining lines stay in the
+// receive buffer and further input in the socket until releaseThrottled
+// resumes it, so a burst only slows the client that sent it.
+void Server::throttleClient(Client* client)
+{
+    if (client->isThrottled())
+        return;
+
+    int fd = client->getFd();
+    Reactor& reactor = *reactors_[clients_[fd].reactor];
+    unsigned long long wake = client->getFloodClock() - floodBurstMicros_;
+    if (reactor.throttled.empty() || wake < reactor.throttleWake)
+        reactor.throttleWake = wake;
+    reactor.throttled.push_back(client);
+    client->setThrottled(true);
+    updatePollEvents(reactor, client);
+    ++stats_.floodThrottles;
+    LOG(LOG_DEBUG, LOG_CLIENT) << "Throttling client " << fd;
+}
+
+// Runs once per loop iteration with the state lock held, after the timers.
+// Clients are resumed in a second pass because handling their lines may
+// throttle or remove others.
+void Server::releaseThrottled(Reactor& reactor)
+{
+    if (reactor.throttled.empty())
+        return;
+    unsigned long long now = currentMicros();
+    if (now < reactor.throttleWake)
+        return;
+
+    std::vector<Client*>& throttled = reactor.throttled;
+    std::vector<Client*> ready;
+    unsigned long long wake = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < throttled.size(); ++i)
+    {
+        Client* client = throttled[i];
+        if (isFlooding(client, now))
+        {
+            unsigned long long clientWake = client->getFloodClock() - floodBurstMicros_;
+            if (kept == 0 || clientWake < wake)
+                wake = clientWake;
+            throttled[kept++] = client;
+        }
+        else
+        {
+            client->setThrottled(false);
+            ready.push_back(client);
+        }
+    }
+    throttled.resize(kept);
+    reactor.throttleWake = wake;
+
+    for (size_t i = 0; i < ready.size(); ++i)
+    {
+        if (isLiveClient(ready[i]))
+            resumeClient(reactor, ready[i]);
+    }
+}
+
+// Gives each client whose read budget ran out last time another pass. It
+// reads with the state lock held, but only ever for these heavy senders.
+void Server::continueReads(Reactor& reactor)
+{
+    if (reactor.pendingReads.empty())
+        return;
+
+    std::vector<Client*> pending;
+    pending.swap(reactor.pendingReads);
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        pending[i]->setReadPending(false);
+    }
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        if (isLiveClient(pending[i]) && !pending[i]->isThrottled())
+            finishRead(pending[i]->getFd(), readClient(pending[i]->getFd()));
+    }
+}
+
+void Server::resumeClient(Reactor& reactor, Client* client)
+{
+    int fd = client->getFd();
+    updatePollEvents(reactor, client);
+    if (!reactor.uring)
+    {
+        // Edge-triggered epoll will not report what already waits in the
+        // socket, so read it now.
+        finishRead(fd, readClient(fd));
+        return;
+    }
+
+    processMessages(fd);
+    while (isLiveClient(client) && !client->isThrottled() && client->hasRecvBacklog())
+    {
+        client->refillFromBacklog();
+        processMessages(fd);
+    }
+    if (isLiveClient(client) && client->isRecvParked() && !client->isThrottled()
+        && !client->hasRecvBacklog())
+    {
+        client->setRecvParked(false);
+        uringArmRecv(reactor, client);
+    }
+}
+
+// Both readiness loops work in two passes: sockets are drained into the
+// per-client buffers without the state lock (only this reactor touches
+// them), then complete lines, disconnects, wakeups, queued output and
+// accepts are handled with the lock held. Clients removed during the batch
+// are only freed at its end, so stale flush entries never dangle.
+void Server::runPoll(Reactor& reactor)
+{
+    std::vector<int> readyFds;
+    std::vector<ReadStatus> readStatus;
+    std::vector<int> writableFds;
+    int timeout = -1;
+
+    while (!shutdownRequested())
+    {
+        int pollResult = poll(&reactor.pollFds[0], reactor.pollFds.size(), timeout);
+
+        if (pollResult == -1)
+        {
+            if (shutdownRequested() || errno == EINTR)
+                continue;
+            throw std::runtime_error("Poll failed");
+        }
+
+        bool acceptPending = false;
+        bool wakePending = false;
+        readyFds.clear();
+        readStatus.clear();
+        writableFds.clear();
+        for (size_t i = 0; i < reactor.pollFds.size(); ++i)
+        {
+            short revents = reactor.pollFds[i].revents;
+            if (i == REACTOR_LISTEN_SLOT)
+                acceptPending = (revents & POLLIN) != 0;
+            else if (i == REACTOR_WAKE_SLOT)
+                wakePending = (revents & POLLIN) != 0;
+            else
+            {
+                if (revents & (POLLIN | POLLHUP | POLLERR))
+                {
+                    readyFds.push_back(reactor.pollFds[i].fd);
+                    readStatus.push_back(readClient(reactor.pollFds[i].fd));
+                }
+                if (revents & POLLOUT)
+                    writableFds.push_back(reactor.pollFds[i].fd);
+            }
+        }
+
+        lockState();
+        runTimers(reactor);
+        releaseThrottled(reactor);
+        for (size_t i = 0; i < readyFds.size(); ++i)
+        {
+            finishRead(readyFds[i], readStatus[i]);
+        }
+        for (size_t i = 0; i < writableFds.size(); ++i)
+        {
+            scheduleFlush(writableFds[i]);
+        }
+        if (wakePending)
+            drainWake(reactor);
+        flushPendingSends(reactor);
+        if (acceptPending)
+            acceptClient(reactor);
+        reapRetiredClients(reactor);
+        timeout = timerWaitMillis(reactor);
+        unlockState();
+    }
+}
+
+void Server::runEpoll(Reactor& reactor)
+{
+#ifdef __linux__
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+    ReadStatus readStatus[EPOLL_MAX_EVENTS];
+    int timeout = -1;
+
+    while (!shutdownRequested())
+    {
+        int ready = epoll_wait(reactor.epollFd, events, EPOLL_MAX_EVENTS, timeout);
+
+        if (ready == -1)
+        {
+            if (shutdownRequested() || errno == EINTR)
+                continue;
+            throw std::runtime_error("epoll_wait failed");
+        }
+
+        for (int i = 0; i < ready; ++i)
+        {
+            int fd = events[i].data.fd;
+            readStatus[i] = READ_DRAINED;
+            if (fd != reactor.listenFd && fd != reactor.wakeFds[0]
+                && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+            {
+                readStatus[i] = readClient(fd);
+            }
+        }
+
+        bool acceptPending = false;
+        lockState();
+        runTimers(reactor);
+        releaseThrottled(reactor);
+        continueReads(reactor);
+        for (int i = 0; i < ready; ++i)
+        {
+            int fd = events[i].data.fd;
+
+            if (fd == reactor.listenFd)
+                acceptPending = true;
+            else if (fd == reactor.wakeFds[0])
+                drainWake(reactor);
+            else
+            {
+                finishRead(fd, readStatus[i]);
+                if (events[i].events & EPOLLOUT)
+                    scheduleFlush(fd);
+            }
+        }
+        flushPendingSends(reactor);
+        if (acceptPending)
+            acceptClient(reactor);
+        reapRetiredClients(reactor);
+        timeout = reactor.pendingReads.empty() ? timerWaitMillis(reactor) : 0;
+        unlockState();
+    }
+#else
+    (void)reactor;
+#endif
+}
+
+// Must be called with the state lock held.
+void Server::scheduleFlush(int fd)
+{
+    Client* client = getClientByFd(fd);
+    if (!client || client->isFlushScheduled())
+        return;
+
+    Reactor& reactor = *reactors_[clients_[fd].reactor];
+    client->setFlushScheduled(true);
+    reactor.flushQueue.push_back(client);
+    if (!pthread_equal(reactor.thread, pthread_self()))
+        wakeReactor(reactor);
+}
+
+void Server::flushPendingSends(Reactor& reactor)
+{
+    // Flushing may disconnect clients, whose QUIT fanout appends to the
+    // queue; the index loop picks those entries up as well.
+    for (size_t i = 0; i < reactor.flushQueue.size(); ++i)
+    {
+        Client* client = reactor.flushQueue[i];
+        client->setFlushScheduled(false);
+        if (!isLiveClient(client))
+            continue;
+        if (client->isSendQueueExceeded())
+        {
+            ++stats_.sendQueueDisconnects;
+            LOG(LOG_WARN, LOG_CLIENT) << "Client " << client->getFd() << " exceeded its SendQ of "
+                << config_.sendQueueLimit << " bytes";
+            removeClient(client->getFd(), "Excess SendQ");
+            continue;
+        }
+        if (reactor.uring)
+        {
+            if (!client->isSendInFlight())
+                uringSubmitSend(reactor, client);
+        }
+        else
+        {
+            flushClient(reactor, client);
+        }
+        if (isLiveClient(client) && client->isClosing() && !client->hasPendingSend())
+            removeClient(client->getFd(), client->getCloseReason());
+    }
+    reactor.flushQueue.clear();
+}
+
+// Writes as much queued output as the socket accepts. Returns false on a
+// socket error; EAGAIN just leaves the remainder queued.
+bool Server::writeClient(Client* client)
+{
+    while (client->hasPendingSend())
+    {
+        ssize_t bytesSent = sendmsg(client->getFd(), client->beginSend(), MSG_NOSIGNAL);
+        ++stats_.sendCalls;
+
+        if (bytesSent > 0)
+        {
+            stats_.sendBytes += static_cast<size_t>(bytesSent);
+            client->completeSend(static_cast<size_t>(bytesSent));
+            continue;
+        }
+        client->completeSend(0);
+        if (bytesSent == -1 && errno == EINTR)
+            continue;
+        return bytesSent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return true;
+}
+
+// Keeps write interest enabled only while bytes remain queued.
+void Server::flushClient(Reactor& reactor, Client* client)
+{
+    if (!writeClient(client))
+    {
+        LOG(LOG_ERROR, LOG_CLIENT) << "Failed to send message to client " << client->getFd();
+        removeClient(client->getFd());
+        return;
+    }
+    setWriteInterest(reactor, client, client->hasPendingSend());
+}
+
+void Server::setWriteInterest(Reactor& reactor, Client* client, bool enable)
+{
+    if (client->isWriteArmed() == enable)
+        return;
+    client->setWriteArmed(enable);
+
+    int fd = client->getFd();
+    updatePollEvents(reactor, client);
+
+#ifdef __linux__
+    if (reactor.epollFd != -1)
+    {
+        struct epoll_event ev;
+        std::memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        if (enable)
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+        if (epoll_ctl(reactor.epollFd, EPOLL_CTL_MOD, fd, &ev) == -1)
+            LOG(LOG_ERROR, LOG_CLIENT) << "Failed to update epoll interest for client " << fd;
+    }
+#endif
+}
+
+// Poll interest follows the client: no POLLIN while it is throttled, so
+// its input waits in the socket, and POLLOUT while output is queued.
+void Server::updatePollEvents(Reactor& reactor, Client* client)
+{
+    short events = client->isThrottled() ? 0 : POLLIN;
+    if (client->isWriteArmed())
+        events |= POLLOUT;
+    reactor.pollFds[clients_[client->getFd()].pollIndex].events = events;
+}
+
+void Server::reapRetiredClients(Reactor& reactor)
+{
+    std::vector<Client*>& retired = reactor.retiredClients;
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (retired[i]->getPendingIo() > 0)
+            retired[kept++] = retired[i];
+        else
+            clientPool_.destroy(retired[i]);
+    }
+    retired.resize(kept);
+}
+
+bool Server::isLiveClient(Client* client)
+{
+    return getClientByFd(client->getFd()) == client;
+}
+
+#ifdef IRC_HAVE_IO_URING
+
+static struct io_uring_sqe* nextSqe(Uring* uring)
+{
+    struct io_uring_sqe* sqe = uring->getSqe();
+    if (!sqe)
+    {
+        // Submission queue is full: hand it to the kernel and retry.
+        uring->submit(0);
+        sqe = uring->getSqe();
+        if (!sqe)
+            throw std::runtime_error("io_uring submission queue is full");
+    }
+    return sqe;
+}
+
+// The ring itself is private to this reactor, so only the wait in
+// io_uring_enter happens without the state lock; completions are handled
+// in batches with the lock held.
+void Server::runUring(Reactor& reactor)
+{
+    Uring* uring = reactor.uring;
+
+    lockState();
+    uringArmAccept(reactor);
+    uringArmWake(reactor);
+    unlockState();
+
+    while (!shutdownRequested())
+    {
+        lockState();
+        flushPendingSends(reactor);
+        reapRetiredClients(reactor);
+        uringArmTimer(reactor);
+        unlockState();
+
+        int ret = uring->submit(1);
+        if (ret < 0)
+        {
+            if (shutdownRequested() || ret == -EINTR)
+                continue;
+            throw std::runtime_error("io_uring_enter failed");
+        }
+
+        lockState();
+        runTimers(reactor);
+        releaseThrottled(reactor);
+        struct io_uring_cqe* cqe;
+        while ((cqe = uring->peekCqe()) != NULL)
+        {
+            unsigned long long userData = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            uring->advanceCq();
+            uringComplete(reactor, userData, res, flags);
+        }
+        unlockState();
+    }
+}
+
+void Server::uringArmAccept(Reactor& reactor)
+{
+    struct io_uring_sqe* sqe = nextSqe(reactor.uring);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = reactor.listenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = URING_OP_ACCEPT;
+}
+
+void Server::uringArmWake(Reactor& reactor)
+{
+    struct io_uring_sqe* sqe = nextSqe(reactor.uring);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = reactor.wakeFds[0];
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = URING_OP_WAKE;
+}
+
+// Wakes the ring at the next tick or throttle release. A timeout is only
+// queued if it fires before the one already in flight; each carries its
+// deadline so the completion can tell whether it was that one.
+void Server::uringArmTimer(Reactor& reactor)
+{
+    int wait = timerWaitMillis(reactor);
+    if (wait < 0)
+        return;
+    unsigned long long deadline = Utils::monotonicNanos() / 1000000ULL + wait;
+    if (reactor.timerDeadline != 0 && reactor.timerDeadline <= deadline)
+        return;
+    struct io_uring_sqe* sqe = nextSqe(reactor.uring);
+    reactor.uring->prepTimeout(sqe, static_cast<unsigned>(wait));
+    sqe->user_data = (deadline << URING_OP_SHIFT) | URING_OP_TIMER;
+    reactor.timerDeadline = deadline;
+}
+
+void Server::uringArmRecv(Reactor& reactor, Client* client)
+{
+    struct io_uring_sqe* sqe = nextSqe(reactor.uring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client->getFd();
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = reinterpret_cast<unsigned long>(client) | URING_OP_RECV;
+    client->addPendingIo();
+}
+
+// Stops the multishot recv of a client whose input is being held back;
+// uringRestartRecv leaves it parked until the client is resumed.
+void Server::uringCancelRecv(Reactor& reactor, Client* client)
+{
+    if (client->isRecvCancelPending() || client->isRecvParked())
+        return;
+    struct io_uring_sqe* sqe = nextSqe(reactor.uring);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = reinterpret_cast<unsigned long>(client) | URING_OP_RECV;
+    sqe->user_data = URING_OP_CANCEL;
+    client->setRecvCancelPending(true);
+}
+
+// Called when a client's recv has ended for good.
+void Server::uringRestartRecv(Reactor& reactor, Client* client)
+{
+    client->setRecvCancelPending(false);
+    if (client->isThrottled() || client->hasRecvBacklog())
+        client->setRecvParked(true);
+    else
+        uringArmRecv(reactor, client);
+}
+
+void Server::uringSubmitSend(Reactor& reactor, Client* client)
+{
+    if (!client->hasPendingSend())
+        return;
+
+    struct io_uring_sqe* sqe = nextSqe(reactor.uring);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = client->getFd();
+    sqe->addr = reinterpret_cast<unsigned long>(client->beginSend());
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<unsigned long>(client) | URING_OP_SEND;
+    client->addPendingIo();
+}
+
+void Server::uringAcceptClient(Reactor& reactor, int clientFd)
+{
+    struct sockaddr_in clientAddr;
+    socklen_t clientLen = sizeof(clientAddr);
+    std::memset(&clientAddr, 0, sizeof(clientAddr));
+    getpeername(clientFd, (struct sockaddr*)&clientAddr, &clientLen);
+
+    Client* newClient = registerClient(reactor, clientFd, clientAddr);
+    if (newClient)
+        uringArmRecv(reactor, newClient);
+}
+
+void Server::uringComplete(Reactor& reactor, unsigned long long userData, int res, unsigned flags)
+{
+    unsigned long long op = userData & URING_OP_MASK;
+    Client* client = reinterpret_cast<Client*>(static_cast<unsigned long>(userData & ~URING_OP_MASK));
+    bool more = (flags & IORING_CQE_F_MORE) != 0;
+
+    if (op == URING_OP_ACCEPT)
+    {
+        if (res >= 0)
+            uringAcceptClient(reactor, res);
+        else if (res == -EINVAL)
+            throw std::runtime_error("io_uring multishot accept is not supported by this kernel");
+        else
+            LOG(LOG_ERROR, LOG_SERVER) << "Failed to accept client connection";
+        if (!more)
+            uringArmAccept(reactor);
+        return;
+    }
+
+    if (op == URING_OP_TIMER)
+    {
+        if ((userData >> URING_OP_SHIFT) == reactor.timerDeadline)
+            reactor.timerDeadline = 0;
+        return;
+    }
+
+    if (op == URING_OP_CANCEL)
+        return;
+
+    if (op == URING_OP_WAKE)
+    {
+        if (res < 0 && res != -ECANCELED)
+            throw std::runtime_error("io_uring poll on wake pipe failed");
+        drainWake(reactor);
+        if (!more)
+            uringArmWake(reactor);
+        return;
+    }
+
+    if (!more)
+        client->releasePendingIo();
+    bool live = isLiveClient(client);
+
+    if (op == URING_OP_SEND)
+    {
+        if (!live)
+            return;
+        if (res < 0)
+        {
+            client->completeSend(0);
+            LOG(LOG_ERROR, LOG_CLIENT) << "Failed to send message to client " << client->getFd();
+            removeClient(client->getFd());
+            return;
+        }
+        ++stats_.sendCalls;
+        stats_.sendBytes += static_cast<size_t>(res);
+        client->completeSend(static_cast<size_t>(res));
+        uringSubmitSend(reactor, client);
+        if (client->isClosing() && !client->hasPendingSend())
+            removeClient(client->getFd(), client->getCloseReason());
+        return;
+    }
+
+    if (flags & IORING_CQE_F_BUFFER)
+    {
+        unsigned short bid = static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0 && live)
+        {
+            ++stats_.recvCalls;
+            stats_.recvBytes += static_cast<size_t>(res);
+            live = receiveChunk(client, reactor.uring->buffer(bid), static_cast<size_t>(res));
+        }
+        reactor.uring->recycleBuffer(bid);
+    }
+    if (!live)
+        return;
+    if (client->hasRecvBacklog())
+        uringCancelRecv(reactor, client);
+
+    int fd = client->getFd();
+    if (res > 0 || res == -ENOBUFS || res == -ECANCELED)
+    {
+        processMessages(fd);
+        if (!more && isLiveClient(client))
+            uringRestartRecv(reactor, client);
+        return;
+    }
+
+    if (res == 0)
+        LOG(LOG_INFO, LOG_CLIENT) << "Client " << fd << " disconnected";
+    else
+        LOG(LOG_ERROR, LOG_CLIENT) << "Error receiving data from client " << fd;
+    removeClient(fd);
+}
+
+#else
+
+void Server::runUring(Reactor& reactor)
+{
+    runPoll(reactor);
+}
+
+void Server::uringArmAccept(Reactor& reactor)
+{
+    (void)reactor;
+}
+
+void Server::uringArmWake(Reactor& reactor)
+{
+    (void)reactor;
+}
+
+void Server::uringArmTimer(Reactor& reactor)
+{
+    (void)reactor;
+}
+
+void Server::uringArmRecv(Reactor& reactor, Client* client)
+{
+    (void)reactor;
+    (void)client;
+}
+
+void Server::uringCancelRecv(Reactor& reactor, Client* client)
+{
+    (void)reactor;
+    (void)client;
+}
+
+void Server::uringRestartRecv(Reactor& reactor, Client* client)
+{
+    (void)reactor;
+    (void)client;
+}
+
+void Server::uringSubmitSend(Reactor& reactor, Client* client)
+{
+    (void)reactor;
+    (void)client;
+}
+
+void Server::uringAcceptClient(Reactor& reactor, int clientFd)
+{
+    (void)reactor;
+    (void)clientFd;
+}
+
+void Server::uringComplete(Reactor& reactor, unsigned long long userData, int res, unsigned flags)
+{
+    (void)reactor;
+    (void)userData;
+    (void)res;
+    (void)flags;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include "IrcMessage.hpp"
+
+bool MessageSlice::empty() const
+{
+    return length == 0;
+}
+
+std::string MessageSlice::str() const
+{
+    return std::string(data, length);
+}
+
+void IrcMessage::assign(const MessageView& view)
+{
+    prefix.assign(view.prefix.data, view.prefix.length);
+    command.assign(view.command.data, view.command.length);
+    params.resize(view.paramCount);
+    for (size_t i = 0; i < view.paramCount; ++i)
+    {
+        params[i].assign(view.params[i].data, view.params[i].length);
+    }
+}
+
+static size_t skipSpaces(const char* line, size_t length, size_t pos)
+{
+    while (pos < length && line[pos] == ' ')
+        ++pos;
+    return pos;
+}
+
+static size_t findSpace(const char* line, size_t length, size_t pos)
+{
+    while (pos < length && line[pos] != ' ')
+        ++pos;
+    return pos;
+}
+
+bool Irc::parseLine(const char* line, size_t length, MessageView& view)
+{
+    size_t pos = skipSpaces(line, length, 0);
+
+    view.prefix.data = line + pos;
+    view.prefix.length = 0;
+    view.paramCount = 0;
+
+    if (pos < length && line[pos] == ':')
+    {
+        size_t end = findSpace(line, length, pos + 1);
+        view.prefix.data = line + pos + 1;
+        view.prefix.length = end - pos - 1;
+        pos = skipSpaces(line, length, end);
+    }
+
+    size_t end = findSpace(line, length, pos);
+    view.command.data = line + pos;
+    view.command.length = end - pos;
+    if (view.command.length == 0)
+        return false;
+    pos = skipSpaces(line, length, end);
+
+    while (pos < length)
+    {
+        MessageSlice& param = view.params[view.paramCount];
+
+        if (line[pos] == ':' || view.paramCount == IRC_MAX_PARAMS - 1)
+        {
+            if (line[pos] == ':')
+                ++pos;
+            param.data = line + pos;
+            param.length = length - pos;
+            if (param.length > 0)
+                ++view.paramCount;
+            break;
+        }
+
+        end = findSpace(line, length, pos);
+        param.data = line + pos;
+        param.length = end - pos;
+        ++view.paramCount;
+        pos = skipSpaces(line, length, end);
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#include "LatencyHistogram.hpp"
+
+#define LATENCY_SUB_COUNT       (1 << LATENCY_SUB_BITS)
+
+// Values below LATENCY_SUB_COUNT get a bucket each; above that, the bucket
+// is the position of the top bit plus the LATENCY_SUB_BITS bits after it.
+static size_t bucketOf(unsigned long long nanos)
+{
+    if (nanos < LATENCY_SUB_COUNT)
+        return static_cast<size_t>(nanos);
+    int top = 63 - __builtin_clzll(nanos);
+    int shift = top - LATENCY_SUB_BITS;
+    size_t sub = static_cast<size_t>(nanos >> shift) & (LATENCY_SUB_COUNT - 1);
+    return static_cast<size_t>(shift + 1) * LATENCY_SUB_COUNT + sub;
+}
+
+static unsigned long long upperEdge(size_t bucket)
+{
+    if (bucket < LATENCY_SUB_COUNT)
+        return bucket;
+    int shift = static_cast<int>(bucket / LATENCY_SUB_COUNT) - 1;
+    unsigned long long mantissa = LATENCY_SUB_COUNT + bucket % LATENCY_SUB_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(unsigned long long nanos)
+{
+    ++buckets[bucketOf(nanos)];
+}
+
+unsigned long long LatencyHistogram::percentile(unsigned long count, double fraction,
+                                                unsigned long long max) const
+{
+    if (count == 0)
+        return 0;
+    unsigned long rank = static_cast<unsigned long>(fraction * count);
+    if (rank < 1)
+        rank = 1;
+    unsigned long seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+            return upperEdge(i) < max ? upperEdge(i) : max;
+    }
+    return max;
+}
@@ -0,0 +1,121 @@
+#include "LineScanner.hpp"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+# define LINE_SCANNER_X86 1
+# include <immintrin.h>
+#endif
+
+typedef size_t (*ScanFunction)(const char*, size_t, size_t*, size_t);
+
+static size_t scanScalar(const char* data, size_t length, size_t* ends, size_t maxEnds)
+{
+    size_t found = 0;
+    size_t offset = 0;
+
+    while (found < maxEnds && offset < length)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(data + offset, '\n', length - offset));
+        if (!newline)
+            break;
+        ends[found++] = newline - data;
+        offset = ends[found - 1] + 1;
+    }
+    return found;
+}
+
+#ifdef LINE_SCANNER_X86
+
+// Appends the positions of the set bits of mask (one per matching byte of
+// the block at base) until maxEnds is reached.
+static inline size_t collectMatches(unsigned mask, size_t base, size_t* ends, size_t found, size_t maxEnds)
+{
+    while (mask != 0 && found < maxEnds)
+    {
+        ends[found++] = base + __builtin_ctz(mask);
+        mask &= mask - 1;
+    }
+    return found;
+}
+
+static size_t scanSse2(const char* data, size_t length, size_t* ends, size_t maxEnds)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t found = 0;
+    size_t offset = 0;
+
+    for (; offset + 16 <= length && found < maxEnds; offset += 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, newline)));
+        found = collectMatches(mask, offset, ends, found, maxEnds);
+    }
+    if (found < maxEnds && offset < length)
+    {
+        size_t tail = scanScalar(data + offset, length - offset, ends + found, maxEnds - found);
+        for (size_t i = found; i < found + tail; ++i)
+            ends[i] += offset;
+        found += tail;
+    }
+    return found;
+}
+
+__attribute__((target("avx2")))
+static size_t scanAvx2(const char* data, size_t length, size_t* ends, size_t maxEnds)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t found = 0;
+    size_t offset = 0;
+
+    for (; offset + 32 <= length && found < maxEnds; offset += 32)
+    {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, newline)));
+        found = collectMatches(mask, offset, ends, found, maxEnds);
+    }
+    if (found < maxEnds && offset < length)
+    {
+        size_t tail = scanSse2(data + offset, length - offset, ends + found, maxEnds - found);
+        for (size_t i = found; i < found + tail; ++i)
+            ends[i] += offset;
+        found += tail;
+    }
+    return found;
+}
+
+static ScanFunction selectScanner()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return scanAvx2;
+    return scanSse2;
+}
+
+#else
+
+static ScanFunction selectScanner()
+{
+    return scanScalar;
+}
+
+#endif
+
+// Resolved once during static initialization, before any thread starts.
+static const ScanFunction scanImpl = selectScanner();
+
+size_t LineScanner::findLineEnds(const char* data, size_t length, size_t* ends, size_t maxEnds)
+{
+    return scanImpl(data, length, ends, maxEnds);
+}
+
+const char* LineScanner::implementation()
+{
+#ifdef LINE_SCANNER_X86
+    if (scanImpl == scanAvx2)
+        return "avx2";
+    if (scanImpl == scanSse2)
+        return "sse2";
+#endif
+    return "scalar";
+}
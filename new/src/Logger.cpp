@@ -0,0 +1,371 @@
+#include "Logger.hpp"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define LOG_WRITE_BATCH         (64 * 1024)
+
+// One ring entry. sequence follows the bounded MPMC queue scheme: equal to
+// the slot's position when free, position + 1 once a producer filled it.
+struct LogSlot
+{
+    unsigned long   sequence;
+    LogLevel        level;
+    size_t          length;
+    char            text[LOG_LINE_MAX];
+};
+
+static LogSlot          ring[LOG_RING_SLOTS];
+static unsigned long    enqueuePos = 0;
+static unsigned long    dequeuePos = 0;
+static unsigned long    droppedLines = 0;
+
+static int              currentLevel = LOG_INFO;
+static int              baseLevel = LOG_INFO;
+static unsigned         sampleEvery[LOG_CATEGORY_COUNT] = { 1, 1, 1 };
+static unsigned long    sampleCount[LOG_CATEGORY_COUNT];
+
+static int              running = 0;
+static int              stopping = 0;
+static pthread_t        writerThread;
+
+// The writer parks on wakeCond once the ring is empty and sets writerIdle
+// first; a producer that publishes a line and then finds the flag set is
+// the one that wakes it, so a busy ring costs producers no lock.
+static int              writerIdle = 0;
+static pthread_mutex_t  wakeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   wakeCond = PTHREAD_COND_INITIALIZER;
+
+static const char* const levelNames[] = { "error", "warn", "info", "debug" };
+static const char* const categoryNames[] = { "server", "client", "wire" };
+
+static void writeAll(int fd, const char* data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = ::write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += written;
+        length -= written;
+    }
+}
+
+static int levelFd(LogLevel level)
+{
+    return level <= LOG_WARN ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+// Copies consecutive lines for the same stream into one buffer and writes
+// it with a single syscall. Returns the number of lines consumed.
+static size_t drainRing()
+{
+    static char batch[LOG_WRITE_BATCH];
+    size_t batchLength = 0;
+    int batchFd = -1;
+    size_t drained = 0;
+
+    for (;;)
+    {
+        LogSlot& slot = ring[dequeuePos & (LOG_RING_SLOTS - 1)];
+        if (__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != dequeuePos + 1)
+            break;
+
+        int fd = levelFd(slot.level);
+        if (batchLength > 0 && (fd != batchFd || batchLength + slot.length + 1 > sizeof(batch)))
+        {
+            writeAll(batchFd, batch, batchLength);
+            batchLength = 0;
+        }
+        batchFd = fd;
+        std::memcpy(batch + batchLength, slot.text, slot.length);
+        batchLength += slot.length;
+        batch[batchLength++] = '\n';
+
+        __atomic_store_n(&slot.sequence, dequeuePos + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+        ++dequeuePos;
+        ++drained;
+    }
+    if (batchLength > 0)
+        writeAll(batchFd, batch, batchLength);
+    return drained;
+}
+
+static bool ringEmpty()
+{
+    const LogSlot& slot = ring[dequeuePos & (LOG_RING_SLOTS - 1)];
+    return __atomic_load_n(&slot.sequence, __ATOMIC_SEQ_CST) != dequeuePos + 1;
+}
+
+static void wakeWriter()
+{
+    pthread_mutex_lock(&wakeMutex);
+    pthread_cond_signal(&wakeCond);
+    pthread_mutex_unlock(&wakeMutex);
+}
+
+static void* writerMain(void*)
+{
+    sigset_t blocked;
+    sigfillset(&blocked);
+    pthread_sigmask(SIG_BLOCK, &blocked, NULL);
+
+    for (;;)
+    {
+        bool stop = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+        if (drainRing() > 0)
+            continue;
+        if (stop)
+            break;
+
+        // Announce the nap before the last look at the ring: a line
+        // published after that look is published by a producer that will
+        // see writerIdle and signal.
+        pthread_mutex_lock(&wakeMutex);
+        __atomic_store_n(&writerIdle, 1, __ATOMIC_SEQ_CST);
+        if (ringEmpty() && !__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+            pthread_cond_wait(&wakeCond, &wakeMutex);
+        __atomic_store_n(&writerIdle, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&wakeMutex);
+    }
+    return NULL;
+}
+
+namespace Log
+{
+    void start()
+    {
+        if (running)
+            return;
+        // Slots start out free: each one's sequence equals its position.
+        for (unsigned long i = 0; i < LOG_RING_SLOTS; ++i)
+        {
+            ring[i].sequence = i;
+        }
+        enqueuePos = 0;
+        dequeuePos = 0;
+        __atomic_store_n(&stopping, 0, __ATOMIC_RELAXED);
+        if (pthread_create(&writerThread, NULL, writerMain, NULL) != 0)
+            return;
+        __atomic_store_n(&running, 1, __ATOMIC_RELEASE);
+    }
+
+    void stop()
+    {
+        if (!running)
+            return;
+        __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+        wakeWriter();
+        pthread_join(writerThread, NULL);
+        __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+        drainRing();
+    }
+
+    void setLevel(LogLevel level)
+    {
+        baseLevel = level;
+        __atomic_store_n(&currentLevel, static_cast<int>(level), __ATOMIC_RELAXED);
+    }
+
+    LogLevel level()
+    {
+        return static_cast<LogLevel>(__atomic_load_n(&currentLevel, __ATOMIC_RELAXED));
+    }
+
+    void toggleDebug()
+    {
+        int next = __atomic_load_n(&currentLevel, __ATOMIC_RELAXED) == LOG_DEBUG ? baseLevel : LOG_DEBUG;
+        __atomic_store_n(&currentLevel, next, __ATOMIC_RELAXED);
+    }
+
+    void setSampling(LogCategory category, unsigned every)
+    {
+        sampleEvery[category] = every > 0 ? every : 1;
+    }
+
+    bool enabled(LogLevel level, LogCategory category)
+    {
+        if (static_cast<int>(level) > __atomic_load_n(&currentLevel, __ATOMIC_RELAXED))
+            return false;
+        unsigned every = sampleEvery[category];
+        if (every == 1)
+            return true;
+        return __atomic_fetch_add(&sampleCount[category], 1, __ATOMIC_RELAXED) % every == 0;
+    }
+
+    void write(LogLevel level, const char* text, size_t length)
+    {
+        if (length > LOG_LINE_MAX)
+            length = LOG_LINE_MAX;
+        // Wire lines carry their own CR-LF; the writer adds the newline.
+        while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+            --length;
+
+        if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE))
+        {
+            char line[LOG_LINE_MAX + 1];
+            std::memcpy(line, text, length);
+            line[length] = '\n';
+            writeAll(levelFd(level), line, length + 1);
+            return;
+        }
+
+        unsigned long pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+        LogSlot* slot;
+        for (;;)
+        {
+            slot = &ring[pos & (LOG_RING_SLOTS - 1)];
+            unsigned long sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+            long diff = static_cast<long>(sequence - pos);
+            if (diff == 0)
+            {
+                if (__atomic_compare_exchange_n(&enqueuePos, &pos, pos + 1, true,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                __atomic_fetch_add(&droppedLines, 1, __ATOMIC_RELAXED);
+                return;
+            }
+            else
+            {
+                pos = __atomic_load_n(&enqueuePos, __ATOMIC_RELAXED);
+            }
+        }
+
+        slot->level = level;
+        slot->length = length;
+        std::memcpy(slot->text, text, length);
+        __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_SEQ_CST);
+
+        // Only the producer that finds the writer parked pays for the
+        // wakeup; the exchange keeps concurrent ones from all signalling.
+        if (__atomic_load_n(&writerIdle, __ATOMIC_SEQ_CST)
+            && __atomic_exchange_n(&writerIdle, 0, __ATOMIC_SEQ_CST))
+            wakeWriter();
+    }
+
+    unsigned long dropped()
+    {
+        return __atomic_load_n(&droppedLines, __ATOMIC_RELAXED);
+    }
+
+    bool parseLevel(const std::string& name, LogLevel& level)
+    {
+        for (int i = LOG_ERROR; i <= LOG_DEBUG; ++i)
+        {
+            if (name == levelNames[i])
+            {
+                level = static_cast<LogLevel>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseCategory(const std::string& name, LogCategory& category)
+    {
+        for (int i = 0; i < LOG_CATEGORY_COUNT; ++i)
+        {
+            if (name == categoryNames[i])
+            {
+                category = static_cast<LogCategory>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+LogBytes::LogBytes(const char* data, size_t length) : data(data), length(length)
+{
+}
+
+LogLine::LogLine(LogLevel level) : level_(level), length_(0)
+{
+}
+
+LogLine::~LogLine()
+{
+    Log::write(level_, text_, length_);
+}
+
+void LogLine::append(const char* data, size_t length)
+{
+    if (length > LOG_LINE_MAX - length_)
+        length = LOG_LINE_MAX - length_;
+    std::memcpy(text_ + length_, data, length);
+    length_ += length;
+}
+
+void LogLine::appendNumber(unsigned long long value, bool negative)
+{
+    char digits[24];
+    size_t pos = sizeof(digits);
+    do
+    {
+        digits[--pos] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    if (negative)
+        digits[--pos] = '-';
+    append(digits + pos, sizeof(digits) - pos);
+}
+
+LogLine& LogLine::operator<<(const char* text)
+{
+    append(text, std::strlen(text));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const std::string& text)
+{
+    append(text.data(), text.size());
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const LogBytes& bytes)
+{
+    append(bytes.data, bytes.length);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(char c)
+{
+    append(&c, 1);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(int value)
+{
+    return *this << static_cast<long>(value);
+}
+
+LogLine& LogLine::operator<<(unsigned value)
+{
+    return *this << static_cast<unsigned long>(value);
+}
+
+LogLine& LogLine::operator<<(long value)
+{
+    if (value < 0)
+        appendNumber(0ULL - static_cast<unsigned long long>(value), true);
+    else
+        appendNumber(static_cast<unsigned long long>(value), false);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long value)
+{
+    appendNumber(value, false);
+    return *this;
+}
@@ -0,0 +1,128 @@
+#include "NameIndex.hpp"
+#include "Utils.hpp"
+
+#define NAME_INDEX_MIN_SLOTS    64
+
+static size_t hashName(const char* name, size_t length)
+{
+    // FNV-1a over the folded bytes.
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= static_cast<unsigned char>(Utils::foldChar(name[i]));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool sameName(const std::string& folded, const char* name, size_t length)
+{
+    if (folded.size() != length)
+        return false;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (folded[i] != Utils::foldChar(name[i]))
+            return false;
+    }
+    return true;
+}
+
+NameIndex::Entry::Entry() : value(-1), used(false)
+{
+}
+
+NameIndex::NameIndex() : entries_(NAME_INDEX_MIN_SLOTS), count_(0)
+{
+}
+
+// The slot holding name, or the empty slot where it would go.
+size_t NameIndex::slotOf(const char* name, size_t length) const
+{
+    size_t mask = entries_.size() - 1;
+    size_t slot = hashName(name, length) & mask;
+    while (entries_[slot].used && !sameName(entries_[slot].key, name, length))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void NameIndex::grow()
+{
+    std::vector<Entry> old(entries_.size() * 2);
+    old.swap(entries_);
+    size_t mask = entries_.size() - 1;
+    for (size_t i = 0; i < old.size(); ++i)
+    {
+        if (!old[i].used)
+            continue;
+        size_t slot = hashName(old[i].key.data(), old[i].key.size()) & mask;
+        while (entries_[slot].used)
+        {
+            slot = (slot + 1) & mask;
+        }
+        entries_[slot].key.swap(old[i].key);
+        entries_[slot].value = old[i].value;
+        entries_[slot].used = true;
+    }
+}
+
+int NameIndex::find(const std::string& name) const
+{
+    return find(name.data(), name.size());
+}
+
+int NameIndex::find(const char* name, size_t length) const
+{
+    const Entry& entry = entries_[slotOf(name, length)];
+    return entry.used ? entry.value : -1;
+}
+
+void NameIndex::insert(const std::string& name, int value)
+{
+    // Stay at most half full so probe runs stay short.
+    if ((count_ + 1) * 2 > entries_.size())
+        grow();
+
+    Entry& entry = entries_[slotOf(name.data(), name.size())];
+    if (!entry.used)
+    {
+        entry.key = Utils::casefold(name);
+        entry.used = true;
+        ++count_;
+    }
+    entry.value = value;
+}
+
+bool NameIndex::erase(const std::string& name)
+{
+    size_t mask = entries_.size() - 1;
+    size_t hole = slotOf(name.data(), name.size());
+    if (!entries_[hole].used)
+        return false;
+
+    // Shift later members of the probe run back over the hole so every
+    // entry stays reachable from its home slot.
+    size_t next = (hole + 1) & mask;
+    while (entries_[next].used)
+    {
+        size_t home = hashName(entries_[next].key.data(), entries_[next].key.size()) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            entries_[hole].key.swap(entries_[next].key);
+            entries_[hole].value = entries_[next].value;
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    entries_[hole].key.clear();
+    entries_[hole].value = -1;
+    entries_[hole].used = false;
+    --count_;
+    return true;
+}
+
+size_t NameIndex::size() const
+{
+    return count_;
+}
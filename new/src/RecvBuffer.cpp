@@ -0,0 +1,104 @@
+#include "RecvBuffer.hpp"
+
+#include <cstring>
+
+RecvBuffer::RecvBuffer()
+    : start_(0), end_(0), scan_(0), lineCount_(0), lineIndex_(0), discarding_(false)
+{
+}
+
+void RecvBuffer::compact()
+{
+    if (start_ == 0)
+        return;
+
+    std::memmove(data_, data_ + start_, end_ - start_);
+    for (size_t i = lineIndex_; i < lineCount_; ++i)
+        lineEnds_[i] -= start_;
+    end_ -= start_;
+    scan_ -= start_;
+    start_ = 0;
+}
+
+char* RecvBuffer::writePtr()
+{
+    return data_ + end_;
+}
+
+size_t RecvBuffer::writeSpace()
+{
+    if (start_ == end_)
+    {
+        start_ = 0;
+        end_ = 0;
+        scan_ = 0;
+    }
+    else if (RECV_BUFFER_SIZE - end_ < IRC_MAX_LINE)
+    {
+        compact();
+    }
+    return RECV_BUFFER_SIZE - end_;
+}
+
+void RecvBuffer::commit(size_t length)
+{
+    end_ += length;
+}
+
+size_t RecvBuffer::append(const char* data, size_t length)
+{
+    size_t space = writeSpace();
+    if (length > space)
+        length = space;
+    std::memcpy(writePtr(), data, length);
+    commit(length);
+    return length;
+}
+
+LineStatus RecvBuffer::nextLine(const char*& line, size_t& length)
+{
+    if (lineIndex_ == lineCount_)
+    {
+        lineIndex_ = 0;
+        lineCount_ = LineScanner::findLineEnds(data_ + scan_, end_ - scan_, lineEnds_, LINE_SCAN_BATCH);
+        for (size_t i = 0; i < lineCount_; ++i)
+            lineEnds_[i] += scan_;
+        scan_ = (lineCount_ == LINE_SCAN_BATCH) ? lineEnds_[lineCount_ - 1] + 1 : end_;
+    }
+
+    if (lineIndex_ == lineCount_)
+    {
+        if (!discarding_ && end_ - start_ >= IRC_MAX_LINE)
+            discarding_ = true;
+        if (discarding_)
+            start_ = end_;
+        return LINE_NONE;
+    }
+
+    size_t lineEnd = lineEnds_[lineIndex_++];
+    line = data_ + start_;
+    length = lineEnd - start_;
+    // The limit counts the terminator as received: CR-LF or a bare LF.
+    bool tooLong = discarding_ || length + 1 > IRC_MAX_LINE;
+    if (length > 0 && line[length - 1] == '\r')
+        --length;
+
+    discarding_ = false;
+    start_ = lineEnd + 1;
+    return tooLong ? LINE_TOO_LONG : LINE_OK;
+}
+
+bool RecvBuffer::empty() const
+{
+    return start_ == end_;
+}
+
+void RecvBuffer::clear()
+{
+    start_ = 0;
+    end_ = 0;
+    scan_ = 0;
+    lineCount_ = 0;
+    lineIndex_ = 0;
+    discarding_ = false;
+}
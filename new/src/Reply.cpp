@@ -0,0 +1,71 @@
+#include "Reply.hpp"
+
+#include <cstring>
+
+#define REPLY_MAX_TEXT          (IRC_MAX_LINE - 2)
+
+ReplyArg::ReplyArg(const char* text) : data(text), length(std::strlen(text))
+{
+}
+
+ReplyArg::ReplyArg(const std::string& text) : data(text.data()), length(text.size())
+{
+}
+
+Reply::Reply(const char* prefix) : length_(0), params_(false)
+{
+    append(prefix);
+}
+
+Reply& Reply::param(const ReplyArg& arg)
+{
+    if (params_)
+        append(" ");
+    params_ = true;
+    return append(arg);
+}
+
+Reply& Reply::trailing(const ReplyArg& arg)
+{
+    append(params_ ? " :" : ":");
+    params_ = true;
+    return append(arg);
+}
+
+Reply& Reply::append(const ReplyArg& arg)
+{
+    size_t length = arg.length;
+    if (length > REPLY_MAX_TEXT - length_)
+        length = REPLY_MAX_TEXT - length_;
+    std::memcpy(line_ + length_, arg.data, length);
+    length_ += length;
+    return *this;
+}
+
+bool Reply::fits(size_t length) const
+{
+    return length <= REPLY_MAX_TEXT - length_;
+}
+
+size_t Reply::size() const
+{
+    return length_;
+}
+
+void Reply::truncate(size_t length)
+{
+    if (length < length_)
+        length_ = length;
+}
+
+const char* Reply::finish()
+{
+    line_[length_] = '\r';
+    line_[length_ + 1] = '\n';
+    return line_;
+}
+
+size_t Reply::finishedSize() const
+{
+    return length_ + 2;
+}
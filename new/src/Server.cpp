@@ -1,59 +1,174 @@
 #include "Server.hpp"
+#include "Uring.hpp"
 #include "Utils.hpp"
+#include "Logger.hpp"
 
-bool Server::signal_ = false;
+#include <sys/resource.h>
 
-Server::Server(int port, const std::string& password) : port_(port), password_(password), serverSocket_(-1)
+int Server::signal_ = 0;
+
+ClientSlot::ClientSlot() : client(NULL), reactor(0), pollIndex(0)
+{
+}
+
+ServerStats::ServerStats()
+    : sendQueueDisconnects(0), sendQueueDrops(0), sendQueueDroppedBytes(0),
+    unknownCommands(0), clients(0), peakClients(0), messagesIn(0), messagesOut(0),
+    sendCalls(0), sendBytes(0), registrationTimeouts(0), pingTimeouts(0), pingsSent(0), pongs(0),
+    rttTotalMillis(0), rttMaxMillis(0), floodThrottles(0), recvCalls(0), recvBytes(0)
+{
+    std::memset(commands, 0, sizeof(commands));
+}
+
+Server::Server(int port, const std::string& password, const ServerConfig& config)
+    : port_(port), password_(password), config_(config), fanoutEpoch_(0), tick_(currentTick()),
+    floodUnitMicros_(config.floodRate ? 1000000ULL / config.floodRate : 0),
+    floodBurstMicros_(floodUnitMicros_ * config.floodBurst),
+    startNanos_(Utils::monotonicNanos()), currentCommand_(-1),
+    clientPool_(stats_.clientPool), channelPool_(stats_.channelPool),
+    membershipPool_(stats_.membershipPool)
 {
+    pthread_mutex_init(&stateMutex_, NULL);
+    // Every client sits in a channel or two; channels are far fewer.
+    clientPool_.reserve(config_.expectedClients);
+    membershipPool_.reserve(config_.expectedClients * 2);
+    channelPool_.reserve(config_.expectedClients / 4);
     initServer();
 }
 
 Server::~Server()
 {
-    for (std::map<int, Client*>::iterator it = clients_.begin(); it != clients_.end(); ++it)
+    for (size_t r = 0; r < reactors_.size(); ++r)
     {
-        close(it->first);
-        delete it->second;
+        Reactor* reactor = reactors_[r];
+        for (size_t i = REACTOR_CLIENT_BASE; i < reactor->pollFds.size(); ++i)
+        {
+            int fd = reactor->pollFds[i].fd;
+            close(fd);
+            clientPool_.destroy(clients_[fd].client);
+        }
+        reactor->pollFds.resize(REACTOR_CLIENT_BASE);
+        closeReactor(*reactor);
+        delete reactor;
     }
+    reactors_.clear();
     clients_.clear();
 
-    for (std::map<std::string, Channel*>::iterator it = channels_.begin(); it != channels_.end(); ++it)
+    for (size_t i = 0; i < channels_.size(); ++i)
     {
-        delete it->second;
+        if (!channels_[i])
+            continue;
+        const std::vector<Membership*>& members = channels_[i]->getMembers();
+        for (size_t j = 0; j < members.size(); ++j)
+        {
+            membershipPool_.destroy(members[j]);
+        }
+        channelPool_.destroy(channels_[i]);
     }
     channels_.clear();
 
-    if (serverSocket_ != -1)
-    {
-        close(serverSocket_);
-    }
+    pthread_mutex_destroy(&stateMutex_);
 }
 
 void Server::signalHandler(int sig)
 {
     (void)sig;
-    std::cout << "\nSignal received, shutting down server..." << std::endl;
-    signal_ = true;
+    static const char message[] = "\nSignal received, shutting down server...\n";
+    int savedErrno = errno;
+    ssize_t written = write(STDOUT_FILENO, message, sizeof(message) - 1);
+    (void)written;
+    errno = savedErrno;
+    requestShutdown();
+}
+
+// The flag is polled by every reactor thread, so it goes through atomic
+// builtins rather than relying on volatile; a lock-free int store is also
+// async-signal-safe.
+void Server::requestShutdown()
+{
+    __atomic_store_n(&signal_, 1, __ATOMIC_RELEASE);
+}
+
+bool Server::shutdownRequested()
+{
+    return __atomic_load_n(&signal_, __ATOMIC_ACQUIRE) != 0;
 }
 
 void Server::initServer()
 {
-    serverSocket_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket_ == -1)
+    if (config_.backend == BACKEND_URING)
+    {
+        Reactor probe(0, this);
+        if (!initUring(probe))
+        {
+            LOG(LOG_WARN, LOG_SERVER) << "io_uring is not available, falling back to poll";
+            config_.backend = BACKEND_POLL;
+        }
+        closeReactor(probe);
+    }
+
+    // Worker threads index the client table concurrently, so size it once
+    // for every descriptor the process may open instead of growing it.
+    if (config_.threads > 1)
+    {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+            clients_.resize(limit.rlim_cur);
+        else
+            clients_.resize(65536);
+    }
+
+    try
+    {
+        for (int i = 0; i < config_.threads; ++i)
+        {
+            Reactor* reactor = new Reactor(i, this);
+            reactors_.push_back(reactor);
+            initReactor(*reactor);
+        }
+    }
+    catch (...)
+    {
+        for (size_t i = 0; i < reactors_.size(); ++i)
+        {
+            closeReactor(*reactors_[i]);
+            delete reactors_[i];
+        }
+        reactors_.clear();
+        pthread_mutex_destroy(&stateMutex_);
+        throw;
+    }
+
+    LOG(LOG_INFO, LOG_SERVER) << "Server started on port " << port_ << " (" << backendName(config_.backend)
+        << ", " << config_.threads << " reactor" << (config_.threads > 1 ? "s" : "") << ")";
+}
+
+int Server::createListenSocket()
+{
+    int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket == -1)
     {
         throw std::runtime_error("Failed to create socket");
     }
 
     int opt = 1;
-    if (setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1)
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) == -1)
     {
-        close(serverSocket_);
+        close(serverSocket);
         throw std::runtime_error("Failed to set socket options");
     }
 
-    if (fcntl(serverSocket_, F_SETFL, O_NONBLOCK) == -1)
+    // Every reactor binds its own listener to the same port and lets the
+    // kernel spread incoming connections across them.
+    if (config_.threads > 1 && setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1)
+    {
+        close(serverSocket);
+        throw std::runtime_error("Failed to set SO_REUSEPORT");
+    }
+
+    if (fcntl(serverSocket, F_SETFL, O_NONBLOCK) == -1)
     {
-        close(serverSocket_);
+        close(serverSocket);
         throw std::runtime_error("Failed to set socket to non-blocking");
     }
 
@@ -63,250 +178,645 @@ void Server::initServer()
     serverAddr.sin_addr.s_addr = INADDR_ANY;
     serverAddr.sin_port = htons(port_);
 
-    if (bind(serverSocket_, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == -1)
+    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == -1)
     {
-        close(serverSocket_);
+        close(serverSocket);
         throw std::runtime_error("Failed to bind socket");
     }
 
-    if (listen(serverSocket_, SOMAXCONN) == -1)
+    if (listen(serverSocket, SOMAXCONN) == -1)
     {
-        close(serverSocket_);
+        close(serverSocket);
         throw std::runtime_error("Failed to listen on socket");
     }
 
-    struct pollfd serverPollFd;
-    serverPollFd.fd = serverSocket_;
-    serverPollFd.events = POLLIN;
-    serverPollFd.revents = 0;
-    pollFds_.push_back(serverPollFd);
-
-    std::cout << "Server started on port " << port_ << std::endl;
+    return serverSocket;
 }
 
-void Server::run()
+// Accepts up to ServerConfig::acceptBudget pending connections per wakeup.
+// The listener is level-triggered, so anything left over is reported again
+// on the next iteration instead of starving already connected clients.
+void Server::acceptClient(Reactor& reactor)
 {
-    while (!signal_)
+    for (int accepted = 0; accepted < config_.acceptBudget; ++accepted)
     {
-        int pollResult = poll(&pollFds_[0], pollFds_.size(), -1);
-        
-        if (pollResult == -1)
+        struct sockaddr_in clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+
+#ifdef __linux__
+        int clientFd = accept4(reactor.listenFd, (struct sockaddr*)&clientAddr, &clientLen,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int clientFd = accept(reactor.listenFd, (struct sockaddr*)&clientAddr, &clientLen);
+#endif
+        if (clientFd == -1)
         {
-            if (signal_)
-                break;
-            throw std::runtime_error("Poll failed");
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                LOG(LOG_ERROR, LOG_SERVER) << "Failed to accept client connection";
+            return;
         }
 
-        for (size_t i = 0; i < pollFds_.size(); ++i)
+#ifndef __linux__
+        if (fcntl(clientFd, F_SETFL, O_NONBLOCK) == -1)
         {
-            if (pollFds_[i].revents & POLLIN)
+            LOG(LOG_ERROR, LOG_CLIENT) << "Failed to set client socket to non-blocking";
+            close(clientFd);
+            continue;
+        }
+#endif
+
+#ifdef __linux__
+        if (reactor.epollFd != -1)
+        {
+            struct epoll_event ev;
+            std::memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            ev.data.fd = clientFd;
+            if (epoll_ctl(reactor.epollFd, EPOLL_CTL_ADD, clientFd, &ev) == -1)
             {
-                if (pollFds_[i].fd == serverSocket_)
-                {
-                    acceptClient();
-                }
-                else
-                {
-                    receiveData(pollFds_[i].fd);
-                }
+                LOG(LOG_ERROR, LOG_CLIENT) << "Failed to register client " << clientFd << " with epoll";
+                close(clientFd);
+                continue;
             }
         }
+#endif
+
+        registerClient(reactor, clientFd, clientAddr);
     }
 }
 
-void Server::acceptClient()
+// Creates the Client record for an accepted socket. The peer address is
+// formatted once here and kept as the client's hostname.
+Client* Server::registerClient(Reactor& reactor, int clientFd, const struct sockaddr_in& clientAddr)
 {
-    struct sockaddr_in clientAddr;
-    socklen_t clientLen = sizeof(clientAddr);
-    
-    int clientFd = accept(serverSocket_, (struct sockaddr*)&clientAddr, &clientLen);
-    if (clientFd == -1)
-    {
-        std::cerr << "Failed to accept client connection" << std::endl;
-        return;
-    }
+    char host[INET_ADDRSTRLEN];
+    if (!inet_ntop(AF_INET, &clientAddr.sin_addr, host, sizeof(host)))
+        std::strcpy(host, "0.0.0.0");
 
-    if (fcntl(clientFd, F_SETFL, O_NONBLOCK) == -1)
+    Client* newClient = new (clientPool_.allocate()) Client(clientFd);
+    newClient->setHostname(host);
+    if (!addClient(newClient, reactor))
     {
-        std::cerr << "Failed to set client socket to non-blocking" << std::endl;
+        clientPool_.destroy(newClient);
         close(clientFd);
-        return;
+        return NULL;
     }
+    newClient->setLastActivity(tick_);
+    reactor.timers.schedule(&newClient->getTimer(), tick_ + REGISTRATION_TIMEOUT);
 
-    struct pollfd clientPollFd;
-    clientPollFd.fd = clientFd;
-    clientPollFd.events = POLLIN;
-    clientPollFd.revents = 0;
-    pollFds_.push_back(clientPollFd);
+    LOG(LOG_INFO, LOG_CLIENT) << "New client connected: " << clientFd << " from " << host;
+    return newClient;
+}
 
-    Client* newClient = new Client(clientFd);
-    newClient->setHostname(inet_ntoa(clientAddr.sin_addr));
-    clients_[clientFd] = newClient;
+// Starts a read pass: drains the socket into the client's receive buffer
+// until EAGAIN (the epoll backend is edge-triggered and will not report
+// this fd again until new data arrives), until the buffer is full, or until
+// the client's read budget is spent, so one busy sender cannot monopolize
+// the loop. Only the owning reactor touches that buffer, so this runs
+// without the state lock.
+ReadStatus Server::readClient(int fd)
+{
+    Client* client = getClientByFd(fd);
+    if (!client)
+        return READ_ERROR;
+    // Left for continueReads, which gives it its next pass.
+    if (client->isReadPending())
+        return READ_DRAINED;
+
+    client->startReadPass();
+    return readSocket(client);
+}
 
-    std::cout << "New client connected: " << clientFd << " from " << inet_ntoa(clientAddr.sin_addr) << std::endl;
+ReadStatus Server::readSocket(Client* client)
+{
+    int fd = client->getFd();
+    while (true)
+    {
+        size_t space;
+        char* buffer = client->getRecvSpace(space);
+        if (space == 0)
+            return READ_FULL;
+        size_t budget = client->getReadBudgetLeft();
+        if (budget == 0)
+            return READ_BUDGET;
+        if (space > budget)
+            space = budget;
+
+        ssize_t bytesReceived = recv(fd, buffer, space, 0);
+        client->noteRecv(bytesReceived > 0 ? static_cast<size_t>(bytesReceived) : 0);
+
+        if (bytesReceived > 0)
+        {
+            client->commitRecv(static_cast<size_t>(bytesReceived));
+            continue;
+        }
+        if (bytesReceived == -1 && errno == EINTR)
+            continue;
+        if (bytesReceived == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return READ_DRAINED;
+        return bytesReceived == 0 ? READ_EOF : READ_ERROR;
+    }
 }
 
-void Server::receiveData(int fd)
+// Books the pass into the server counters and resizes the client's budget.
+void Server::endReadPass(Client* client, ReadStatus status)
 {
-    char buffer[1024];
-    std::memset(buffer, 0, sizeof(buffer));
-    
-    ssize_t bytesReceived = recv(fd, buffer, sizeof(buffer) - 1, 0);
-    
-    if (bytesReceived <= 0)
+    if (client->getReadPassCalls() == 0)
+        return;
+    stats_.recvCalls += client->getReadPassCalls();
+    stats_.recvBytes += client->getReadPassBytes();
+    client->adaptReadBudget(status == READ_BUDGET);
+    client->startReadPass();
+}
+
+void Server::finishRead(int fd, ReadStatus status)
+{
+    Client* client = getClientByFd(fd);
+    if (!client)
+        return;
+
+    // A full buffer may leave data in the socket that edge-triggered epoll
+    // will not report again, so keep alternating until it is drained. A
+    // throttled client's data stays in the socket until it is resumed.
+    while (status == READ_FULL)
     {
-        if (bytesReceived == 0)
+        processMessages(fd);
+        if (getClientByFd(fd) != client || client->isThrottled())
         {
-            std::cout << "Client " << fd << " disconnected" << std::endl;
+            endReadPass(client, status);
+            return;
         }
-        else
+        status = readSocket(client);
+    }
+    endReadPass(client, status);
+
+    // Lines that arrived together with the EOF are still handled.
+    processMessages(fd);
+    if (getClientByFd(fd) != client || status == READ_DRAINED)
+        return;
+
+    if (status == READ_BUDGET)
+    {
+        // Poll reports the rest again by itself; epoll comes back to it on
+        // the next iteration without waiting.
+        Reactor& reactor = *reactors_[clients_[fd].reactor];
+        if (reactor.epollFd != -1 && !client->isThrottled() && !client->isReadPending())
         {
-            std::cerr << "Error receiving data from client " << fd << std::endl;
+            client->setReadPending(true);
+            reactor.pendingReads.push_back(client);
         }
-        removeClient(fd);
         return;
     }
 
-    Client* client = clients_[fd];
-    client->appendToBuffer(std::string(buffer, bytesReceived));
+    if (status == READ_EOF)
+        LOG(LOG_INFO, LOG_CLIENT) << "Client " << fd << " disconnected";
+    else
+        LOG(LOG_ERROR, LOG_CLIENT) << "Error receiving data from client " << fd;
+    removeClient(fd);
+}
+
+// Appends a received chunk, handling buffered lines whenever the receive
+// buffer fills up. What a throttled client cannot fit is held back until
+// it is resumed. Returns false if the client was removed meanwhile.
+bool Server::receiveChunk(Client* client, const char* data, size_t length)
+{
+    size_t stored = client->hasRecvBacklog() ? 0 : client->appendToBuffer(data, length);
+    while (stored < length && !client->isThrottled() && !client->hasRecvBacklog())
+    {
+        processMessages(client->getFd());
+        if (!isLiveClient(client))
+            return false;
+        stored += client->appendToBuffer(data + stored, length - stored);
+    }
+    if (stored < length)
+        client->holdRecv(data + stored, length - stored);
+    return true;
+}
 
-    while (client->hasCompleteMessage())
+void Server::processMessages(int fd)
+{
+    Client* client = getClientByFd(fd);
+    if (!client)
+        return;
+
+    // One clock read per batch; the flood clock only moves as lines are
+    // charged, so the check stays exact within the batch.
+    unsigned long long now = floodUnitMicros_ ? currentMicros() : 0;
+    const char* line;
+    size_t length;
+    LineStatus status;
+    while (true)
     {
-        std::string message = client->extractMessage();
-        if (!message.empty())
+        if (isFlooding(client, now))
+        {
+            throttleClient(client);
+            return;
+        }
+        if ((status = client->extractLine(line, length)) == LINE_NONE)
+            break;
+        if (client->isClosing())
+            continue;
+        if (status == LINE_TOO_LONG)
         {
-            handleClientMessage(fd, message);
+            chargeFlood(client, 1);
+            sendNumeric(fd, NUMERIC(ERR_INPUTTOOLONG), client->getNickname(), "Input line was too long");
+            continue;
+        }
+        if (length > 0)
+        {
+            ++stats_.messagesIn;
+            client->setLastActivity(tick_);
+            handleClientMessage(fd, line, length);
+            if (getClientByFd(fd) != client)
+                return;
         }
     }
 }
 
-void Server::handleClientMessage(int fd, const std::string& message)
+void Server::handleClientMessage(int fd, const char* line, size_t length)
 {
-    std::cout << "Received from " << fd << ": " << message << std::endl;
-    parseCommand(fd, message);
+    LOG(LOG_DEBUG, LOG_WIRE) << "Received from " << fd << ": " << LogBytes(line, length);
+
+    MessageView message;
+    if (Irc::parseLine(line, length, message))
+        parseCommand(fd, message);
 }
 
-void Server::removeClient(int fd)
+bool Server::addClient(Client* client, Reactor& reactor)
 {
-    Client* client = clients_[fd];
-    if (client)
+    int fd = client->getFd();
+    if (static_cast<size_t>(fd) >= clients_.size())
     {
-        std::set<std::string> channels = client->getChannels();
-        for (std::set<std::string>::iterator it = channels.begin(); it != channels.end(); ++it)
+        if (reactors_.size() > 1)
         {
-            Channel* channel = getChannel(*it);
-            if (channel)
-            {
-                std::string quitMsg = ":" + client->getPrefix() + " QUIT :Client disconnected\r\n";
-                sendToChannel(channel, quitMsg, fd);
-                channel->removeClient(fd);
-                if (channel->isEmpty())
-                {
-                    removeChannel(*it);
-                }
-            }
+            LOG(LOG_ERROR, LOG_CLIENT) << "Client fd " << fd << " exceeds the descriptor table";
+            return false;
         }
-        delete client;
-        clients_.erase(fd);
+        clients_.resize(fd + 1);
     }
 
-    for (std::vector<struct pollfd>::iterator it = pollFds_.begin(); it != pollFds_.end(); ++it)
+    struct pollfd clientPollFd;
+    clientPollFd.fd = fd;
+    clientPollFd.events = POLLIN;
+    clientPollFd.revents = 0;
+    reactor.pollFds.push_back(clientPollFd);
+
+    clients_[fd].client = client;
+    clients_[fd].reactor = reactor.id;
+    clients_[fd].pollIndex = reactor.pollFds.size() - 1;
+    if (++stats_.clients > stats_.peakClients)
+        stats_.peakClients = stats_.clients;
+    return true;
+}
+
+// A client's single timer holds whichever deadline applies to it: finish
+// registering, go quiet for PING_INTERVAL, or answer the PING in time.
+// Activity only stamps lastActivity; the timer catches up when it fires,
+// so busy clients cost nothing per line.
+void Server::handleTimer(Client* client)
+{
+    int fd = client->getFd();
+    TimerWheel& timers = timersOf(fd);
+
+    // Its ERROR has not drained within CLOSE_LINGER.
+    if (client->isClosing())
     {
-        if (it->fd == fd)
+        removeClient(fd, client->getCloseReason());
+        return;
+    }
+
+    if (!client->isRegistered())
+    {
+        ++stats_.registrationTimeouts;
+        closeClient(client, "Registration timeout");
+        return;
+    }
+
+    if (client->isAwaitingPong() && client->getLastActivity() <= client->getPingTick())
+    {
+        ++stats_.pingTimeouts;
+        closeClient(client, "Ping timeout");
+        return;
+    }
+
+    std::vector<int> expired;
+    client->takeExpiredInvites(tick_, expired);
+    for (size_t i = 0; i < expired.size(); ++i)
+    {
+        atoms_.release(expired[i]);
+    }
+
+    unsigned long idleDeadline = client->getLastActivity() + PING_INTERVAL;
+    if (idleDeadline > tick_)
+    {
+        client->clearAwaitingPong();
+        timers.schedule(&client->getTimer(), idleDeadline);
+        return;
+    }
+
+    // Re-arm before sending: a full SendQ may remove the client, which
+    // cancels the timer again.
+    timers.schedule(&client->getTimer(), tick_ + PONG_TIMEOUT);
+    client->notePingSent(tick_, Utils::monotonicNanos());
+    ++stats_.pingsSent;
+    sendToClient(fd, "PING :" SERVER_NAME "\r\n");
+}
+
+// Queues ERROR and leaves the disconnect to the flush pass, so the line
+// is written before the socket is closed; under io_uring, or with write
+// interest armed, nothing is written synchronously. The timer cuts off a
+// peer that does not read it within CLOSE_LINGER.
+void Server::closeClient(Client* client, const char* reason)
+{
+    int fd = client->getFd();
+    sendToClient(fd, std::string("ERROR :Closing link (") + reason + ")\r\n");
+    client->closeAfterFlush(reason);
+    timersOf(fd).schedule(&client->getTimer(), tick_ + CLOSE_LINGER);
+    scheduleFlush(fd);
+}
+
+// Drops client from one of its reactor's short work lists.
+static void forgetClient(std::vector<Client*>& list, Client* client)
+{
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+        if (list[i] == client)
         {
-            pollFds_.erase(it);
-            break;
+            list[i] = list.back();
+            list.pop_back();
+            return;
         }
     }
+}
+
+void Server::removeClient(int fd, const std::string& reason)
+{
+    Client* client = getClientByFd(fd);
+    if (!client)
+    {
+        close(fd);
+        return;
+    }
+
+    Reactor& reactor = *reactors_[clients_[fd].reactor];
+    --stats_.clients;
+
+    if (nicks_.find(client->getNickname()) == fd)
+        nicks_.erase(client->getNickname());
+
+    sendToCommonChannels(client, ":" + client->getPrefix() + " QUIT :" + reason + "\r\n");
+    while (!client->getMemberships().empty())
+    {
+        leaveChannel(client->getMemberships().back());
+    }
+    const std::vector<ClientInvite>& invites = client->getInvites();
+    for (size_t i = 0; i < invites.size(); ++i)
+    {
+        atoms_.release(invites[i].channelAtom);
+    }
+    reactor.timers.cancel(&client->getTimer());
+    if (client->isThrottled())
+        forgetClient(reactor.throttled, client);
+    if (client->isReadPending())
+        forgetClient(reactor.pendingReads, client);
+
+    // The client may still sit in a flush queue or, with io_uring, be the
+    // target of in-flight requests; it is freed once the reactor reaps it.
+    if (reactor.uring)
+        shutdown(fd, SHUT_RDWR);
+    reactor.retiredClients.push_back(client);
+
+    // Swap the last pollfd into the freed slot so removal stays O(1).
+    size_t index = clients_[fd].pollIndex;
+    size_t last = reactor.pollFds.size() - 1;
+    if (index != last)
+    {
+        reactor.pollFds[index] = reactor.pollFds[last];
+        clients_[reactor.pollFds[index].fd].pollIndex = index;
+    }
+    reactor.pollFds.pop_back();
+    clients_[fd] = ClientSlot();
+
+#ifdef __linux__
+    if (reactor.epollFd != -1)
+    {
+        epoll_ctl(reactor.epollFd, EPOLL_CTL_DEL, fd, NULL);
+    }
+#endif
 
     close(fd);
 }
 
 void Server::sendToClient(int fd, const std::string& message)
 {
-    std::cout << "Sending to " << fd << ": " << message;
-    if (send(fd, message.c_str(), message.length(), 0) == -1)
+    SharedBuffer* buffer = SharedBuffer::create(message);
+    sendToClient(fd, buffer);
+    buffer->release();
+}
+
+void Server::sendReply(int fd, Reply& reply)
+{
+    const char* line = reply.finish();
+    SharedBuffer* buffer = SharedBuffer::create(line, reply.finishedSize());
+    sendToClient(fd, buffer);
+    buffer->release();
+}
+
+// ":ft_irc NNN target :text" and the same with one or two middle params.
+void Server::sendNumeric(int fd, const char* prefix, const ReplyArg& target, const ReplyArg& text)
+{
+    Reply reply(prefix);
+    reply.param(target).trailing(text);
+    sendReply(fd, reply);
+}
+
+void Server::sendNumeric(int fd, const char* prefix, const ReplyArg& target, const ReplyArg& arg,
+                         const ReplyArg& text)
+{
+    Reply reply(prefix);
+    reply.param(target).param(arg).trailing(text);
+    sendReply(fd, reply);
+}
+
+void Server::sendNumeric(int fd, const char* prefix, const ReplyArg& target, const ReplyArg& arg1,
+                         const ReplyArg& arg2, const ReplyArg& text)
+{
+    Reply reply(prefix);
+    reply.param(target).param(arg1).param(arg2).trailing(text);
+    sendReply(fd, reply);
+}
+
+// A reactor writing to an idle socket it owns sends straight away. Anything
+// else is queued and written by the owning reactor after the current batch,
+// which is woken first if the message came from another thread.
+void Server::sendToClient(int fd, SharedBuffer* buffer, SendPriority priority)
+{
+    LOG(LOG_DEBUG, LOG_WIRE) << "Sending to " << fd << ": " << LogBytes(buffer->data(), buffer->size());
+    Client* client = getClientByFd(fd);
+    if (!client || client->isSendQueueExceeded() || client->isClosing())
+        return;
+
+    if (client->getSendQueueBytes() + buffer->size() > config_.sendQueueLimit)
     {
-        std::cerr << "Failed to send message to client " << fd << std::endl;
+        if (config_.sendQueuePolicy == SENDQ_DROP && priority == SEND_BULK)
+        {
+            ++stats_.sendQueueDrops;
+            stats_.sendQueueDroppedBytes += buffer->size();
+            return;
+        }
+        // The flush pass disconnects it; removing it here could pull the
+        // client out from under the command handler that is sending.
+        client->setSendQueueExceeded();
+        scheduleFlush(fd);
+        return;
+    }
+
+    client->queueSend(buffer);
+    ++stats_.messagesOut;
+    if (currentCommand_ >= 0)
+        ++stats_.commands[currentCommand_].messagesOut;
+
+    // Errors are left for the flush pass for the same reason.
+    Reactor& reactor = *reactors_[clients_[fd].reactor];
+    if (!reactor.uring && !client->isWriteArmed() && !client->isFlushScheduled()
+        && pthread_equal(reactor.thread, pthread_self())
+        && writeClient(client) && !client->hasPendingSend())
+    {
+        return;
     }
+    scheduleFlush(fd);
+}
+
+// The line is serialized once; every recipient queues a reference to it.
+void Server::sendToChannel(Channel* channel, const std::string& message, int excludeFd,
+                           SendPriority priority)
+{
+    SharedBuffer* buffer = SharedBuffer::create(message);
+    sendToChannel(channel, buffer, excludeFd, priority);
+    buffer->release();
 }
 
-void Server::sendToChannel(Channel* channel, const std::string& message, int excludeFd)
+void Server::sendToChannel(Channel* channel, SharedBuffer* buffer, int excludeFd,
+                           SendPriority priority)
 {
-    std::set<int> clients = channel->getClients();
-    for (std::set<int>::iterator it = clients.begin(); it != clients.end(); ++it)
+    const std::vector<Membership*>& members = channel->getMembers();
+    for (size_t i = 0; i < members.size(); ++i)
     {
-        if (*it != excludeFd)
+        if (members[i]->fd != excludeFd)
         {
-            sendToClient(*it, message);
+            sendToClient(members[i]->fd, buffer, priority);
         }
     }
 }
 
-void Server::broadcastToAll(const std::string& message, int excludeFd)
+// Sends message once to every client sharing a channel with client, but not
+// to client itself. Walks client's own memberships, so the cost is the sum
+// of those channels' sizes and no channel is looked up by name.
+void Server::sendToCommonChannels(Client* client, const std::string& message)
 {
-    for (std::map<int, Client*>::iterator it = clients_.begin(); it != clients_.end(); ++it)
+    const std::vector<Membership*>& memberships = client->getMemberships();
+    if (memberships.empty())
+        return;
+
+    SharedBuffer* buffer = SharedBuffer::create(message);
+    unsigned long epoch = ++fanoutEpoch_;
+    client->markFanout(epoch);
+    for (size_t i = 0; i < memberships.size(); ++i)
     {
-        if (it->first != excludeFd)
+        const std::vector<Membership*>& members = memberships[i]->channel->getMembers();
+        for (size_t j = 0; j < members.size(); ++j)
         {
-            sendToClient(it->first, message);
+            if (members[j]->client->markFanout(epoch))
+            {
+                sendToClient(members[j]->fd, buffer);
+            }
         }
     }
+    buffer->release();
 }
 
-Client* Server::getClientByNick(const std::string& nick)
+void Server::broadcastToAll(const std::string& message, int excludeFd)
 {
-    for (std::map<int, Client*>::iterator it = clients_.begin(); it != clients_.end(); ++it)
+    SharedBuffer* buffer = SharedBuffer::create(message);
+    for (size_t r = 0; r < reactors_.size(); ++r)
     {
-        if (Utils::toLower(it->second->getNickname()) == Utils::toLower(nick))
+        const std::vector<struct pollfd>& pollFds = reactors_[r]->pollFds;
+        for (size_t i = REACTOR_CLIENT_BASE; i < pollFds.size(); ++i)
         {
-            return it->second;
+            if (pollFds[i].fd != excludeFd)
+            {
+                sendToClient(pollFds[i].fd, buffer);
+            }
         }
     }
-    return NULL;
+    buffer->release();
+}
+
+Client* Server::getClientByNick(const std::string& nick)
+{
+    int fd = nicks_.find(nick);
+    return fd < 0 ? NULL : getClientByFd(fd);
 }
 
 Client* Server::getClientByFd(int fd)
 {
-    std::map<int, Client*>::iterator it = clients_.find(fd);
-    if (it != clients_.end())
+    if (fd < 0 || static_cast<size_t>(fd) >= clients_.size())
     {
-        return it->second;
+        return NULL;
     }
-    return NULL;
+    return clients_[fd].client;
 }
 
 Channel* Server::getChannel(const std::string& name)
 {
-    std::string lowerName = Utils::toLower(name);
-    std::map<std::string, Channel*>::iterator it = channels_.find(lowerName);
-    if (it != channels_.end())
-    {
-        return it->second;
-    }
-    return NULL;
+    int atom = atoms_.find(name);
+    return atom < 0 ? NULL : channels_[atom];
 }
 
 Channel* Server::createChannel(const std::string& name, Client* creator)
 {
-    std::string lowerName = Utils::toLower(name);
-    Channel* channel = new Channel(name);
-    channel->addClient(creator->getFd());
-    channel->addOperator(creator->getFd());
-    channels_[lowerName] = channel;
-    creator->addChannel(lowerName);
+    int atom = atoms_.acquire(name);
+    if (static_cast<size_t>(atom) >= channels_.size())
+        channels_.resize(atom + 1, NULL);
+    Channel* channel = new (channelPool_.allocate()) Channel(name, atom);
+    channels_[atom] = channel;
+    joinChannel(creator, channel, MEMBER_OPERATOR);
     return channel;
 }
 
-void Server::removeChannel(const std::string& name)
+Membership* Server::joinChannel(Client* client, Channel* channel, unsigned char flags)
 {
-    std::string lowerName = Utils::toLower(name);
-    std::map<std::string, Channel*>::iterator it = channels_.find(lowerName);
-    if (it != channels_.end())
-    {
-        delete it->second;
-        channels_.erase(it);
-    }
+    Membership* membership = new (membershipPool_.allocate()) Membership();
+    membership->client = client;
+    membership->channel = channel;
+    membership->fd = client->getFd();
+    membership->flags = flags;
+    channel->addMember(membership);
+    client->addMembership(membership);
+    return membership;
+}
+
+// Unlinks membership from both sides and frees it, dropping the channel
+// once its last member has left.
+void Server::leaveChannel(Membership* membership)
+{
+    Channel* channel = membership->channel;
+    channel->removeMember(membership);
+    membership->client->removeMembership(membership);
+    membershipPool_.destroy(membership);
+    if (channel->isEmpty())
+        removeChannel(channel);
+}
+
+// Invites may keep the name atom alive after the channel is gone.
+void Server::removeChannel(Channel* channel)
+{
+    int atom = channel->getAtom();
+    channels_[atom] = NULL;
+    channelPool_.destroy(channel);
+    atoms_.release(atom);
 }
 
 bool Server::isNickInUse(const std::string& nick)
@@ -314,6 +824,11 @@ bool Server::isNickInUse(const std::string& nick)
     return getClientByNick(nick) != NULL;
 }
 
+const ServerStats& Server::getStats() const
+{
+    return stats_;
+}
+
 std::string Server::getPassword() const
 {
     return password_;
@@ -0,0 +1,73 @@
+#include "SharedBuffer.hpp"
+#include "ObjectPool.hpp"
+#include "RecvBuffer.hpp"
+
+#include <cstring>
+#include <new>
+
+// Storage for one pooled buffer: the header and a full IRC line.
+struct LineBlock
+{
+    char    bytes[sizeof(SharedBuffer) + IRC_MAX_LINE];
+};
+
+static PoolStats                linePoolStats;
+static ObjectPool<LineBlock>    linePool(linePoolStats);
+
+SharedBuffer::SharedBuffer(size_t size) : refs_(1), size_(size)
+{
+}
+
+SharedBuffer::~SharedBuffer()
+{
+}
+
+SharedBuffer* SharedBuffer::create(const std::string& data)
+{
+    return create(data.data(), data.size());
+}
+
+SharedBuffer* SharedBuffer::create(const char* data, size_t size)
+{
+    void* memory;
+    if (size <= IRC_MAX_LINE)
+        memory = linePool.allocate();
+    else
+        memory = ::operator new(sizeof(SharedBuffer) + size);
+    SharedBuffer* buffer = new (memory) SharedBuffer(size);
+    std::memcpy(static_cast<char*>(memory) + sizeof(SharedBuffer), data, size);
+    return buffer;
+}
+
+void SharedBuffer::retain()
+{
+    ++refs_;
+}
+
+void SharedBuffer::release()
+{
+    if (--refs_ == 0)
+    {
+        size_t size = size_;
+        this->~SharedBuffer();
+        if (size <= IRC_MAX_LINE)
+            linePool.destroy(reinterpret_cast<LineBlock*>(this));
+        else
+            ::operator delete(this);
+    }
+}
+
+const char* SharedBuffer::data() const
+{
+    return reinterpret_cast<const char*>(this + 1);
+}
+
+size_t SharedBuffer::size() const
+{
+    return size_;
+}
+
+const PoolStats& SharedBuffer::poolStats()
+{
+    return linePoolStats;
+}
@@ -0,0 +1,146 @@
+#include "TimerWheel.hpp"
+
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_SPAN        (1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+static void initList(TimerNode* head)
+{
+    head->prev = head;
+    head->next = head;
+}
+
+static void linkTail(TimerNode* head, TimerNode* node)
+{
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void unlink(TimerNode* node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+TimerNode::TimerNode() : prev(NULL), next(NULL), expires(0), owner(NULL)
+{
+}
+
+bool TimerNode::isArmed() const
+{
+    return next != NULL;
+}
+
+TimerWheel::TimerWheel() : base_(0), count_(0)
+{
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level)
+    {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; ++slot)
+        {
+            initList(&slots_[level][slot]);
+        }
+    }
+    initList(&expired_);
+}
+
+// A timer goes to the lowest level whose span still reaches its deadline;
+// the slot index comes from the deadline's bits at that level, so it is
+// reached (directly or by cascading) exactly when the deadline is due.
+void TimerWheel::place(TimerNode* node)
+{
+    unsigned long delta = node->expires - base_;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1UL << (TIMER_WHEEL_BITS * (level + 1))))
+        ++level;
+    size_t slot = (node->expires >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    linkTail(&slots_[level][slot], node);
+}
+
+// Redistributes the level's current slot over the levels below and
+// returns its index; 0 means this level wrapped too.
+size_t TimerWheel::cascade(int level)
+{
+    size_t slot = (base_ >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+    TimerNode* head = &slots_[level][slot];
+    while (head->next != head)
+    {
+        TimerNode* node = head->next;
+        unlink(node);
+        place(node);
+    }
+    return slot;
+}
+
+void TimerWheel::schedule(TimerNode* node, unsigned long expires)
+{
+    if (node->isArmed())
+        unlink(node);
+    else
+        ++count_;
+    if (expires < base_)
+        expires = base_;
+    if (expires - base_ >= TIMER_WHEEL_SPAN)
+        expires = base_ + TIMER_WHEEL_SPAN - 1;
+    node->expires = expires;
+    place(node);
+}
+
+void TimerWheel::cancel(TimerNode* node)
+{
+    if (!node->isArmed())
+        return;
+    unlink(node);
+    --count_;
+}
+
+void TimerWheel::advance(unsigned long now)
+{
+    // Nothing to walk through: jump the clock forward.
+    if (count_ == 0)
+    {
+        if (now >= base_)
+            base_ = now + 1;
+        return;
+    }
+
+    while (base_ <= now)
+    {
+        size_t slot = base_ & TIMER_WHEEL_MASK;
+        if (slot == 0)
+        {
+            for (int level = 1; level < TIMER_WHEEL_LEVELS && cascade(level) == 0; ++level)
+                ;
+        }
+        TimerNode* head = &slots_[0][slot];
+        while (head->next != head)
+        {
+            TimerNode* node = head->next;
+            unlink(node);
+            linkTail(&expired_, node);
+        }
+        ++base_;
+    }
+}
+
+TimerNode* TimerWheel::nextExpired()
+{
+    if (expired_.next == &expired_)
+        return NULL;
+    TimerNode* node = expired_.next;
+    unlink(node);
+    --count_;
+    return node;
+}
+
+bool TimerWheel::empty() const
+{
+    return count_ == 0;
+}
+
+size_t TimerWheel::size() const
+{
+    return count_;
+}
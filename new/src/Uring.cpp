@@ -0,0 +1,231 @@
+#include "Uring.hpp"
+
+#ifdef IRC_HAVE_IO_URING
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int ioUringSetup(unsigned entries, struct io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+static int ioUringRegister(int fd, unsigned opcode, void* arg, unsigned nrArgs)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+Uring::Uring()
+    : ringFd_(-1), sqEntries_(0), cqEntries_(0),
+    sqRing_(MAP_FAILED), sqRingSize_(0), cqRing_(MAP_FAILED), cqRingSize_(0),
+    sqes_(NULL), sqesSize_(0),
+    sqHead_(NULL), sqTail_(NULL), sqMask_(NULL), sqArray_(NULL),
+    cqHead_(NULL), cqTail_(NULL), cqMask_(NULL), cqes_(NULL),
+    sqeTail_(0), sqeHead_(0),
+    bufRing_(NULL), bufRingSize_(0), bufBase_(NULL), bufTail_(0)
+{
+}
+
+Uring::~Uring()
+{
+    if (bufRing_)
+    {
+        struct io_uring_buf_reg reg;
+        std::memset(&reg, 0, sizeof(reg));
+        reg.bgid = URING_BUF_GROUP;
+        ioUringRegister(ringFd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        munmap(bufRing_, bufRingSize_);
+    }
+    delete[] bufBase_;
+
+    if (sqes_)
+        munmap(sqes_, sqesSize_);
+    if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+        munmap(cqRing_, cqRingSize_);
+    if (sqRing_ != MAP_FAILED)
+        munmap(sqRing_, sqRingSize_);
+    if (ringFd_ != -1)
+        close(ringFd_);
+}
+
+bool Uring::init(unsigned entries)
+{
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    // Multishot recv can complete many times per submission; give the
+    // completion queue headroom so it does not overflow under bursts.
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    ringFd_ = ioUringSetup(entries, &params);
+    if (ringFd_ == -1)
+        return false;
+
+    sqEntries_ = params.sq_entries;
+    cqEntries_ = params.cq_entries;
+
+    sqRingSize_ = params.sq_off.array + sqEntries_ * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + cqEntries_ * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap && cqRingSize_ > sqRingSize_)
+        sqRingSize_ = cqRingSize_;
+
+    sqRing_ = mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+        return false;
+
+    if (singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+            return false;
+    }
+
+    sqesSize_ = sqEntries_ * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    char* cq = static_cast<char*>(cqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    sqeTail_ = *sqTail_;
+    sqeHead_ = sqeTail_;
+    return true;
+}
+
+bool Uring::initBufferRing()
+{
+    bufRingSize_ = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    void* ring = mmap(NULL, bufRingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        return false;
+
+    struct io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<unsigned long>(ring);
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid = URING_BUF_GROUP;
+    if (ioUringRegister(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        munmap(ring, bufRingSize_);
+        return false;
+    }
+
+    bufRing_ = static_cast<struct io_uring_buf_ring*>(ring);
+    bufBase_ = new char[URING_BUF_COUNT * URING_BUF_SIZE];
+    bufTail_ = 0;
+    for (unsigned short bid = 0; bid < URING_BUF_COUNT; ++bid)
+    {
+        recycleBuffer(bid);
+    }
+    return true;
+}
+
+struct io_uring_sqe* Uring::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (sqeTail_ - head >= sqEntries_)
+        return NULL;
+
+    struct io_uring_sqe* sqe = &sqes_[sqeTail_ & *sqMask_];
+    ++sqeTail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// The kernel reads the timespec when the request is submitted, so one
+// slot serves as long as at most one timeout is queued per submit.
+void Uring::prepTimeout(struct io_uring_sqe* sqe, unsigned millis)
+{
+    timeout_.tv_sec = millis / 1000;
+    timeout_.tv_nsec = static_cast<long long>(millis % 1000) * 1000000LL;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = reinterpret_cast<unsigned long>(&timeout_);
+    sqe->len = 1;
+}
+
+void Uring::flushSq()
+{
+    unsigned tail = *sqTail_;
+    while (sqeHead_ != sqeTail_)
+    {
+        sqArray_[tail & *sqMask_] = sqeHead_ & *sqMask_;
+        ++tail;
+        ++sqeHead_;
+    }
+    __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+}
+
+int Uring::submit(unsigned waitNr)
+{
+    flushSq();
+    unsigned pending = *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+    unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    if (pending == 0 && waitNr == 0)
+        return 0;
+
+    int ret = ioUringEnter(ringFd_, pending, waitNr, flags);
+    if (ret < 0)
+        return -errno;
+    return ret;
+}
+
+struct io_uring_cqe* Uring::peekCqe()
+{
+    unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &cqes_[head & *cqMask_];
+}
+
+void Uring::advanceCq()
+{
+    __atomic_store_n(cqHead_, *cqHead_ + 1, __ATOMIC_RELEASE);
+}
+
+char* Uring::buffer(unsigned short bid)
+{
+    return bufBase_ + static_cast<size_t>(bid) * URING_BUF_SIZE;
+}
+
+void Uring::recycleBuffer(unsigned short bid)
+{
+    // Index the ring by hand: the uapi flexible-array member is laid out
+    // differently when the header is compiled as C++.
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufRing_)
+                               + (bufTail_ & (URING_BUF_COUNT - 1));
+    buf->addr = reinterpret_cast<unsigned long>(buffer(bid));
+    buf->len = URING_BUF_SIZE;
+    buf->bid = bid;
+    ++bufTail_;
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+}
+
+#endif
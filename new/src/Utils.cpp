@@ -1,6 +1,7 @@
 #include "Utils.hpp"
 #include <cctype>
 #include <algorithm>
+#include <ctime>
 
 namespace Utils
 {
@@ -81,6 +82,23 @@ std::string toLower(const std::string& str)
     return result;
 }
 
+char foldChar(char c)
+{
+    if (c >= 'A' && c <= '^')
+        return static_cast<char>(c + ('a' - 'A'));
+    return c;
+}
+
+std::string casefold(const std::string& str)
+{
+    std::string result = str;
+    for (size_t i = 0; i < result.length(); ++i)
+    {
+        result[i] = foldChar(result[i]);
+    }
+    return result;
+}
+
 bool isValidNickname(const std::string& nick)
 {
     if (nick.empty() || nick.length() > 9)
@@ -157,4 +175,11 @@ std::string trim(const std::string& str)
     return str.substr(start, end - start);
 }
 
+unsigned long long monotonicNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<unsigned long long>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
 }
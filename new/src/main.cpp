@@ -1,4 +1,6 @@
 #include "Server.hpp"
+#include "Logger.hpp"
+#include "LineScanner.hpp"
 #include <cstdlib>
 #include <iostream>
 
@@ -17,16 +19,170 @@ static bool isValidPort(const std::string& portStr)
     return port >= 1 && port <= 65535;
 }
 
+// Parses a decimal option value and checks it against [min, max].
+static bool parseNumber(const std::string& value, unsigned long min, unsigned long max,
+                        unsigned long& result)
+{
+    if (value.empty() || value.length() > 10)
+        return false;
+
+    for (size_t i = 0; i < value.length(); ++i)
+    {
+        if (!std::isdigit(value[i]))
+            return false;
+    }
+
+    result = std::strtoul(value.c_str(), NULL, 10);
+    return result >= min && result <= max;
+}
+
+static bool parseOption(const std::string& arg, ServerConfig& config)
+{
+    const std::string backendOpt = "--backend=";
+    const std::string threadsOpt = "--threads=";
+    const std::string cpusOpt = "--cpus=";
+    const std::string acceptBudgetOpt = "--accept-budget=";
+    const std::string sendqOpt = "--sendq=";
+    const std::string sendqPolicyOpt = "--sendq-policy=";
+    const std::string expectedClientsOpt = "--expected-clients=";
+    const std::string floodRateOpt = "--flood-rate=";
+    const std::string floodBurstOpt = "--flood-burst=";
+    const std::string operPasswordOpt = "--oper-password=";
+    const std::string logLevelOpt = "--log-level=";
+    const std::string logSampleOpt = "--log-sample=";
+    unsigned long number;
+
+    if (arg.compare(0, backendOpt.length(), backendOpt) == 0)
+        return Server::parseBackend(arg.substr(backendOpt.length()), config.backend);
+    if (arg.compare(0, threadsOpt.length(), threadsOpt) == 0)
+    {
+        if (!parseNumber(arg.substr(threadsOpt.length()), 1, MAX_REACTOR_THREADS, number))
+            return false;
+        config.threads = static_cast<int>(number);
+        return true;
+    }
+    if (arg.compare(0, cpusOpt.length(), cpusOpt) == 0)
+        return Server::parseCpuList(arg.substr(cpusOpt.length()), config.cpus);
+    if (arg.compare(0, acceptBudgetOpt.length(), acceptBudgetOpt) == 0)
+    {
+        if (!parseNumber(arg.substr(acceptBudgetOpt.length()), 1, MAX_ACCEPT_BUDGET, number))
+            return false;
+        config.acceptBudget = static_cast<int>(number);
+        return true;
+    }
+    if (arg.compare(0, sendqOpt.length(), sendqOpt) == 0)
+    {
+        if (!parseNumber(arg.substr(sendqOpt.length()), 512, 4000000000UL, number))
+            return false;
+        config.sendQueueLimit = number;
+        return true;
+    }
+    if (arg.compare(0, sendqPolicyOpt.length(), sendqPolicyOpt) == 0)
+        return Server::parseSendQueuePolicy(arg.substr(sendqPolicyOpt.length()), config.sendQueuePolicy);
+    if (arg.compare(0, expectedClientsOpt.length(), expectedClientsOpt) == 0)
+    {
+        if (!parseNumber(arg.substr(expectedClientsOpt.length()), 0, MAX_EXPECTED_CLIENTS, number))
+            return false;
+        config.expectedClients = number;
+        return true;
+    }
+    if (arg.compare(0, floodRateOpt.length(), floodRateOpt) == 0)
+    {
+        if (!parseNumber(arg.substr(floodRateOpt.length()), 0, MAX_FLOOD_RATE, number))
+            return false;
+        config.floodRate = static_cast<unsigned>(number);
+        return true;
+    }
+    if (arg.compare(0, floodBurstOpt.length(), floodBurstOpt) == 0)
+    {
+        if (!parseNumber(arg.substr(floodBurstOpt.length()), 1, MAX_FLOOD_BURST, number))
+            return false;
+        config.floodBurst = static_cast<unsigned>(number);
+        return true;
+    }
+    if (arg.compare(0, operPasswordOpt.length(), operPasswordOpt) == 0)
+    {
+        config.operPassword = arg.substr(operPasswordOpt.length());
+        return !config.operPassword.empty();
+    }
+    if (arg.compare(0, logLevelOpt.length(), logLevelOpt) == 0)
+    {
+        LogLevel level;
+        if (!Log::parseLevel(arg.substr(logLevelOpt.length()), level))
+            return false;
+        Log::setLevel(level);
+        return true;
+    }
+    if (arg.compare(0, logSampleOpt.length(), logSampleOpt) == 0)
+    {
+        std::string value = arg.substr(logSampleOpt.length());
+        size_t colon = value.find(':');
+        LogCategory category;
+        if (colon == std::string::npos || !Log::parseCategory(value.substr(0, colon), category)
+            || !parseNumber(value.substr(colon + 1), 1, 1000000, number))
+            return false;
+        Log::setSampling(category, static_cast<unsigned>(number));
+        return true;
+    }
+    return false;
+}
+
+static void toggleDebugLog(int sig)
+{
+    (void)sig;
+    Log::toggleDebug();
+}
+
+static void printUsage(const char* name)
+{
+    std::cerr << "Usage: " << name << " <port> <password> [options]" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --backend=epoll|poll|io_uring   event loop backend (default: "
+              << Server::backendName(ServerConfig().backend) << ")" << std::endl;
+    std::cerr << "  --threads=N                     event loop threads, 1-" << MAX_REACTOR_THREADS
+              << " (default: 1)" << std::endl;
+    std::cerr << "  --cpus=0,1,...                  pin event loop threads to these CPUs" << std::endl;
+    std::cerr << "  --accept-budget=N               connections accepted per wakeup, 1-" << MAX_ACCEPT_BUDGET
+              << " (default: " << DEFAULT_ACCEPT_BUDGET << ")" << std::endl;
+    std::cerr << "  --sendq=BYTES                   per-client SendQ limit, at least 512 (default: "
+              << DEFAULT_SENDQ_LIMIT << ")" << std::endl;
+    std::cerr << "  --sendq-policy=disconnect|drop  what to do when a client exceeds it (default: disconnect)"
+              << std::endl;
+    std::cerr << "  --expected-clients=N            pre-size client and channel pools, 0-" << MAX_EXPECTED_CLIENTS
+              << " (default: 0)" << std::endl;
+    std::cerr << "  --flood-rate=N                  command cost units a client earns per second, 0 disables"
+              << " (default: " << DEFAULT_FLOOD_RATE << ")" << std::endl;
+    std::cerr << "  --flood-burst=N                 cost units a client may spend at once, 1-" << MAX_FLOOD_BURST
+              << " (default: " << DEFAULT_FLOOD_BURST << ")" << std::endl;
+    std::cerr << "  --oper-password=PASSWORD        enables OPER, which unlocks STATS (default: disabled)"
+              << std::endl;
+    std::cerr << "  --log-level=error|warn|info|debug  log verbosity; debug logs every line (default: info)"
+              << std::endl;
+    std::cerr << "  --log-sample=CATEGORY:N         keep 1 in N server, client or wire log lines" << std::endl;
+    std::cerr << "SIGUSR1 toggles debug logging while the server runs." << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc != 3)
+    if (argc < 3)
     {
-        std::cerr << "Usage: " << argv[0] << " <port> <password>" << std::endl;
+        printUsage(argv[0]);
         return 1;
     }
     
     std::string portStr = argv[1];
     std::string password = argv[2];
+    ServerConfig config;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        if (!parseOption(argv[i], config))
+        {
+            std::cerr << "Error: Unknown or invalid option: " << argv[i] << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
     
     if (!isValidPort(portStr))
     {
@@ -42,22 +198,44 @@ int main(int argc, char* argv[])
     
     int port = std::atoi(portStr.c_str());
     
+    Log::start();
     try
     {
-        Server server(port, password);
+        Server server(port, password, config);
         
         signal(SIGINT, Server::signalHandler);
         signal(SIGQUIT, Server::signalHandler);
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGUSR1, toggleDebugLog);
         
         std::cout << "IRC Server starting..." << std::endl;
         std::cout << "Port: " << port << std::endl;
         std::cout << "Password: " << password << std::endl;
+        std::cout << "Backend: " << Server::backendName(config.backend) << std::endl;
+        std::cout << "Threads: " << config.threads << std::endl;
+        std::cout << "Line scanner: " << LineScanner::implementation() << std::endl;
         std::cout << "Press Ctrl+C to stop the server." << std::endl;
         
         server.run();
+        Log::stop();
+
+        const ServerStats& stats = server.getStats();
+        std::cout << "SendQ limit hits: " << stats.sendQueueDisconnects << " disconnected, "
+                  << stats.sendQueueDrops << " messages dropped (" << stats.sendQueueDroppedBytes
+                  << " bytes)" << std::endl;
+        std::cout << "Keepalive: " << stats.pingsSent << " PINGs sent, " << stats.pingTimeouts
+                  << " ping timeouts, " << stats.registrationTimeouts << " registration timeouts" << std::endl;
+        std::cout << "Receive: " << stats.recvBytes << " bytes in " << stats.recvCalls << " recv calls ("
+                  << (stats.recvCalls ? stats.recvBytes / stats.recvCalls : 0) << " bytes/call)" << std::endl;
+        std::cout << "Flood control: " << stats.floodThrottles << " throttles" << std::endl;
+        std::cout << "Pool peaks: " << stats.clientPool.peak << " clients, " << stats.channelPool.peak
+                  << " channels, " << stats.membershipPool.peak << " memberships, "
+                  << SharedBuffer::poolStats().peak << " line buffers" << std::endl;
+        std::cout << "Log lines dropped: " << Log::dropped() << std::endl;
     }
     catch (const std::exception& e)
     {
+        Log::stop();
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
@@ -0,0 +1,234 @@
+#include "IrcMessage.hpp"
+#include "Utils.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define FUZZ_LINES          200000
+#define FUZZ_MAX_LENGTH     160
+
+// Fuzz equivalence between Irc::parseLine and the splitter it replaced,
+// Utils::splitCommand. Both must agree on every line except where the new
+// parser deliberately differs:
+//  - a leading ":prefix" is split off instead of becoming the command;
+//  - after IRC_MAX_PARAMS - 1 middle parameters the rest of the line is
+//    the last parameter, which splitCommand splits into further tokens.
+// Prefixed lines are checked as ":prefix " + line against line itself,
+// and for the second rule the raw tail is re-split with splitCommand.
+
+static unsigned long rngState = 12345;
+
+static unsigned long nextRandom()
+{
+    rngState = rngState * 6364136223846793005UL + 1442695040888963407UL;
+    return rngState >> 33;
+}
+
+static std::string escape(const std::string& line)
+{
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < line.length(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(line[i]);
+        if (c >= 0x20 && c < 0x7f && c != '\\')
+        {
+            out += static_cast<char>(c);
+            continue;
+        }
+        out += "\\x";
+        out += hex[c >> 4];
+        out += hex[c & 15];
+    }
+    return out;
+}
+
+static bool fail(const std::string& line, const std::string& what)
+{
+    std::string shown = escape(line);
+    if (shown.length() > 120)
+        shown = shown.substr(0, 120) + "... (" + Utils::intToString(static_cast<int>(line.length())) + " bytes)";
+    std::cerr << "IrcMessageTest: mismatch (" << what << ") on \"" << shown << "\"" << std::endl;
+    return false;
+}
+
+// Checks one line without a prefix against splitCommand.
+static bool checkLine(const std::string& line)
+{
+    std::vector<std::string> tokens = Utils::splitCommand(line);
+    MessageView view;
+    bool parsed = Irc::parseLine(line.data(), line.length(), view);
+
+    if (parsed != !tokens.empty())
+        return fail(line, "command presence");
+    if (!parsed)
+        return true;
+    if (!view.prefix.empty())
+        return fail(line, "unexpected prefix");
+    if (view.command.str() != tokens[0])
+        return fail(line, "command");
+
+    size_t middle = view.paramCount < IRC_MAX_PARAMS ? view.paramCount : IRC_MAX_PARAMS - 1;
+    if (tokens.size() - 1 < middle)
+        return fail(line, "parameter count");
+    for (size_t i = 0; i < middle; ++i)
+    {
+        if (view.params[i].str() != tokens[i + 1])
+            return fail(line, "parameter " + Utils::intToString(static_cast<int>(i)));
+    }
+
+    if (view.paramCount < IRC_MAX_PARAMS)
+    {
+        if (tokens.size() - 1 != view.paramCount)
+            return fail(line, "parameter count");
+        return true;
+    }
+
+    // Last parameter: splitting its raw text (with the ':' the parser
+    // stripped) must give the tokens splitCommand produced from there on.
+    const MessageSlice& last = view.params[IRC_MAX_PARAMS - 1];
+    size_t rawStart = last.data - line.data();
+    if (rawStart > 0 && line[rawStart - 1] == ':')
+        --rawStart;
+    std::vector<std::string> tail = Utils::splitCommand("X " + line.substr(rawStart));
+    if (tail.size() != tokens.size() - IRC_MAX_PARAMS + 1)
+        return fail(line, "tail token count");
+    for (size_t i = 1; i < tail.size(); ++i)
+    {
+        if (tail[i] != tokens[IRC_MAX_PARAMS - 1 + i])
+            return fail(line, "tail token");
+    }
+    return true;
+}
+
+// ":prefix " + line must parse like line, plus the prefix.
+static bool checkPrefixed(const std::string& prefix, const std::string& line)
+{
+    std::string prefixed = ":" + prefix + " " + line;
+    MessageView plain;
+    MessageView view;
+    bool plainParsed = Irc::parseLine(line.data(), line.length(), plain);
+    bool parsed = Irc::parseLine(prefixed.data(), prefixed.length(), view);
+
+    if (parsed != plainParsed)
+        return fail(prefixed, "command presence with prefix");
+    if (view.prefix.str() != prefix)
+        return fail(prefixed, "prefix");
+    if (!parsed)
+        return true;
+    if (view.command.str() != plain.command.str() || view.paramCount != plain.paramCount)
+        return fail(prefixed, "command or parameter count with prefix");
+    for (size_t i = 0; i < view.paramCount; ++i)
+    {
+        if (view.params[i].str() != plain.params[i].str())
+            return fail(prefixed, "parameter with prefix");
+    }
+
+    IrcMessage message;
+    message.assign(view);
+    if (message.prefix != prefix || message.command != view.command.str()
+        || message.params.size() != view.paramCount)
+        return fail(prefixed, "IrcMessage::assign");
+    return true;
+}
+
+// Lines whose first word starts with ':' already carry a prefix and are
+// outside what splitCommand understood.
+static bool checkBoth(const std::string& line, const std::string& prefix)
+{
+    size_t start = line.find_first_not_of(' ');
+    if (start != std::string::npos && line[start] == ':')
+        return true;
+    return checkLine(line) && checkPrefixed(prefix, line);
+}
+
+static std::string randomLine()
+{
+    // Spaces and colons dominate so separators and trailing markers land
+    // in every position.
+    static const char alphabet[] = "  ::  aB#&!@,.\t\x01\x7f\xff";
+    size_t length = nextRandom() % FUZZ_MAX_LENGTH;
+    std::string line;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (nextRandom() % 64 == 0)
+            line += '\0';
+        else
+            line += alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+    }
+    return line;
+}
+
+static std::string randomPrefix()
+{
+    static const char alphabet[] = "nick!user@host.:#";
+    std::string prefix;
+    size_t length = nextRandom() % 12;
+    for (size_t i = 0; i < length; ++i)
+        prefix += alphabet[nextRandom() % (sizeof(alphabet) - 1)];
+    return prefix;
+}
+
+static std::vector<std::string> adversarialLines()
+{
+    std::vector<std::string> lines;
+    lines.push_back("");
+    lines.push_back(" ");
+    lines.push_back(":");
+    lines.push_back("::");
+    lines.push_back(" :CMD");
+    lines.push_back("CMD");
+    lines.push_back("CMD :");
+    lines.push_back("CMD ::");
+    lines.push_back("CMD a:b :c:d");
+    lines.push_back("   CMD    a     b    :  trailing  ");
+    lines.push_back("CMD" + std::string(10000, ' ') + "a" + std::string(10000, ' '));
+    lines.push_back(std::string(5000, ' ') + "CMD");
+    lines.push_back("CMD " + std::string(3000, ':'));
+
+    std::string many = "CMD";
+    for (int i = 0; i < 40; ++i)
+        many += " p" + Utils::intToString(i);
+    lines.push_back(many);
+    lines.push_back(many + " :trailing words");
+    lines.push_back(many + "   ");
+
+    for (size_t count = 12; count <= 17; ++count)
+    {
+        std::string line = "CMD";
+        for (size_t i = 0; i < count; ++i)
+            line += " x";
+        lines.push_back(line);
+        lines.push_back(line + " :");
+        lines.push_back(line + " :tail");
+        lines.push_back(line + "  :tail  with  spaces ");
+    }
+    return lines;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        rngState = std::strtoul(argv[1], NULL, 10);
+    unsigned long seed = rngState;
+
+    std::vector<std::string> fixed = adversarialLines();
+    for (size_t i = 0; i < fixed.size(); ++i)
+    {
+        if (!checkBoth(fixed[i], "nick!user@host"))
+            return 1;
+    }
+
+    for (int i = 0; i < FUZZ_LINES; ++i)
+    {
+        std::string line = randomLine();
+        if (!checkBoth(line, randomPrefix()))
+            return 1;
+    }
+
+    std::cout << "IrcMessageTest: " << fixed.size() + FUZZ_LINES << " lines match splitCommand (seed "
+              << seed << ")" << std::endl;
+    return 0;
+}
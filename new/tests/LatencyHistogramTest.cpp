@@ -0,0 +1,93 @@
+#include "LatencyHistogram.hpp"
+
+#include <iostream>
+#include <cstring>
+
+// Percentiles read back from LatencyHistogram must stay ordered and never
+// exceed the largest sample, although bucket upper edges can lie past it:
+// p50 <= p99 <= max for every sample set, with each percentile at or
+// above the exact value of its rank.
+
+struct SampleSet
+{
+    const char*                 name;
+    const unsigned long long*   samples;
+    size_t                      count;
+};
+
+static const unsigned long long single[] = { 111177 };
+static const unsigned long long sameBucket[] = { 98000, 101000, 105000, 111177 };
+static const unsigned long long spread[] = { 0, 3, 7, 900, 1500, 20000, 20001, 350000, 4000000, 111177 };
+static const unsigned long long small[] = { 1, 2, 2, 3 };
+static const unsigned long long huge[] = { 1000ULL, 18000000000000000000ULL };
+
+static const SampleSet sets[] = {
+    { "single", single, sizeof(single) / sizeof(single[0]) },
+    { "same bucket", sameBucket, sizeof(sameBucket) / sizeof(sameBucket[0]) },
+    { "spread", spread, sizeof(spread) / sizeof(spread[0]) },
+    { "small", small, sizeof(small) / sizeof(small[0]) },
+    { "huge", huge, sizeof(huge) / sizeof(huge[0]) }
+};
+
+// The sample of the given rank (1-based), as percentile() ranks them.
+static unsigned long long exactRank(const SampleSet& set, double fraction)
+{
+    unsigned long rank = static_cast<unsigned long>(fraction * set.count);
+    if (rank < 1)
+        rank = 1;
+    unsigned long long sorted[16];
+    std::memcpy(sorted, set.samples, set.count * sizeof(sorted[0]));
+    for (size_t i = 1; i < set.count; ++i)
+    {
+        for (size_t j = i; j > 0 && sorted[j - 1] > sorted[j]; --j)
+        {
+            unsigned long long swap = sorted[j];
+            sorted[j] = sorted[j - 1];
+            sorted[j - 1] = swap;
+        }
+    }
+    return sorted[rank - 1];
+}
+
+static bool checkSet(const SampleSet& set)
+{
+    LatencyHistogram histogram;
+    std::memset(&histogram, 0, sizeof(histogram));
+    unsigned long long max = 0;
+    for (size_t i = 0; i < set.count; ++i)
+    {
+        histogram.record(set.samples[i]);
+        if (set.samples[i] > max)
+            max = set.samples[i];
+    }
+
+    unsigned long long p50 = histogram.percentile(set.count, 0.50, max);
+    unsigned long long p99 = histogram.percentile(set.count, 0.99, max);
+    if (p50 <= p99 && p99 <= max && p50 >= exactRank(set, 0.50) && p99 >= exactRank(set, 0.99))
+        return true;
+
+    std::cerr << "LatencyHistogramTest: " << set.name << ": p50=" << p50 << " p99=" << p99
+              << " max=" << max << " (exact p50=" << exactRank(set, 0.50) << " p99="
+              << exactRank(set, 0.99) << ")" << std::endl;
+    return false;
+}
+
+int main()
+{
+    LatencyHistogram empty;
+    std::memset(&empty, 0, sizeof(empty));
+    if (empty.percentile(0, 0.50, 0) != 0)
+    {
+        std::cerr << "LatencyHistogramTest: an empty histogram must report 0" << std::endl;
+        return 1;
+    }
+
+    size_t count = sizeof(sets) / sizeof(sets[0]);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!checkSet(sets[i]))
+            return 1;
+    }
+    std::cout << "LatencyHistogramTest: " << count << " sample sets keep p50 <= p99 <= max" << std::endl;
+    return 0;
+}